@@ -0,0 +1,505 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED                                             *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ ***************************************************************************/
+
+#define SEISCOMP_COMPONENT NLLGridCache
+
+#include <seiscomp/logging/log.h>
+#include <seiscomp/client/application.h>
+#include <seiscomp/system/environment.h>
+#include <seiscomp/utils/files.h>
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+using namespace std;
+using namespace Seiscomp;
+
+
+namespace {
+
+
+// The cached copy of a travel time table mirrors its absolute path below
+// the cache directory. The marker file is written after all grids have
+// been copied and tells the NonLinLoc plugin to use the cached table.
+string cachedTablePath(const string &cacheDir, const string &tablePath) {
+	return cacheDir + tablePath;
+}
+
+
+string markerPath(const string &cacheDir, const string &tablePath) {
+	return cachedTablePath(cacheDir, tablePath) + ".cached";
+}
+
+
+string dirName(const string &path) {
+	size_t pos = path.rfind('/');
+	return pos == string::npos ? "." : path.substr(0, pos);
+}
+
+
+string baseName(const string &path) {
+	size_t pos = path.rfind('/');
+	return pos == string::npos ? path : path.substr(pos+1);
+}
+
+
+bool endsWith(const string &str, const string &suffix) {
+	return str.size() >= suffix.size() &&
+	       str.compare(str.size()-suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+// Quantised grid buffer file layout, must match GRID_QUANT_* in
+// libs/3rd-party/nll/GridLib.h
+const char *QuantMagic = "NLLQBUF1";
+const int QuantBlock = 8;
+const uint16_t QuantInvalid = 65535;
+
+
+// Returns the names of all grid files (buffers and headers) of a table
+vector<string> tableFiles(const string &tablePath) {
+	vector<string> files;
+	string prefix = baseName(tablePath) + ".";
+
+	DIR *dir = opendir(dirName(tablePath).c_str());
+	if ( dir == nullptr ) return files;
+
+	struct dirent *entry;
+	while ( (entry = readdir(dir)) != nullptr ) {
+		string name = entry->d_name;
+		if ( name.compare(0, prefix.size(), prefix) != 0 ) continue;
+		if ( !endsWith(name, ".buf") && !endsWith(name, ".qbuf") && !endsWith(name, ".hdr") ) continue;
+		files.push_back(name);
+	}
+
+	closedir(dir);
+	return files;
+}
+
+
+bool copyFile(const string &source, const string &target) {
+	ifstream in(source.c_str(), ios::binary);
+	if ( !in.is_open() ) return false;
+
+	// Copy to a temporary file first, processes having the previous copy
+	// mapped keep their pages after the rename
+	string tmp = target + ".tmp";
+	ofstream out(tmp.c_str(), ios::binary | ios::trunc);
+	if ( !out.is_open() ) return false;
+
+	out << in.rdbuf();
+	out.close();
+
+	if ( !out || rename(tmp.c_str(), target.c_str()) != 0 ) {
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+void swapBytes(void *data, size_t n, size_t size) {
+	char *bytes = static_cast<char*>(data);
+	for ( size_t i = 0; i < n; ++i, bytes += size )
+		reverse(bytes, bytes + size);
+}
+
+
+// Reads the grid dimensions from the first line of a grid header. Only
+// regular float grids can be quantised.
+bool readGridDimensions(const string &hdrPath, int &nx, int &ny, int &nz) {
+	ifstream hdr(hdrPath.c_str());
+	string line;
+	if ( !getline(hdr, line) ) return false;
+
+	double orig[3], d[3];
+	string type, floatType;
+	istringstream is(line);
+	if ( !(is >> nx >> ny >> nz >> orig[0] >> orig[1] >> orig[2] >> d[0] >> d[1] >> d[2] >> type) )
+		return false;
+
+	if ( (is >> floatType) && floatType != "FLOAT" ) return false;
+
+	while ( getline(hdr, line) ) {
+		if ( line.compare(0, 14, "CASCADING_GRID") == 0 ) return false;
+	}
+
+	return nx > 0 && ny > 0 && nz > 0;
+}
+
+
+// Writes a grid buffer as quantised grid buffer: blocks of QuantBlock^3
+// nodes are stored as 16 bit codes relative to the minimum of the block.
+// Returns the maximum absolute error of the stored values or a negative
+// value on failure.
+double quantizeGrid(const string &source, const string &target,
+                    int nx, int ny, int nz, bool swap) {
+	size_t n = (size_t)nx * ny * nz;
+	vector<float> values(n);
+
+	ifstream in(source.c_str(), ios::binary);
+	if ( !in.read(reinterpret_cast<char*>(&values[0]), n * sizeof(float)) )
+		return -1;
+	if ( swap ) swapBytes(&values[0], n, sizeof(float));
+
+	int nbx = (nx + QuantBlock - 1) / QuantBlock;
+	int nby = (ny + QuantBlock - 1) / QuantBlock;
+	int nbz = (nz + QuantBlock - 1) / QuantBlock;
+	size_t nblock = (size_t)nbx * nby * nbz;
+	size_t blockSize = QuantBlock * QuantBlock * QuantBlock;
+
+	vector<float> offsets(nblock, 0), scales(nblock, 0);
+	vector<uint16_t> codes(nblock * blockSize, 0);
+	double maxError = 0;
+
+	for ( int bx = 0; bx < nbx; ++bx ) {
+		for ( int by = 0; by < nby; ++by ) {
+			for ( int bz = 0; bz < nbz; ++bz ) {
+				size_t block = ((size_t)bx * nby + by) * nbz + bz;
+				int x1 = min(nx, (bx+1)*QuantBlock);
+				int y1 = min(ny, (by+1)*QuantBlock);
+				int z1 = min(nz, (bz+1)*QuantBlock);
+
+				// Negative values flag invalid nodes and are not
+				// quantised
+				float vmin = 0, vmax = 0;
+				bool valid = false;
+				for ( int ix = bx*QuantBlock; ix < x1; ++ix ) {
+					for ( int iy = by*QuantBlock; iy < y1; ++iy ) {
+						for ( int iz = bz*QuantBlock; iz < z1; ++iz ) {
+							float v = values[((size_t)ix*ny + iy)*nz + iz];
+							if ( !(v >= 0) ) continue;
+							if ( !valid || v < vmin ) vmin = v;
+							if ( !valid || v > vmax ) vmax = v;
+							valid = true;
+						}
+					}
+				}
+
+				float scale = (vmax - vmin) / (QuantInvalid - 1);
+				offsets[block] = vmin;
+				scales[block] = scale;
+
+				for ( int ix = bx*QuantBlock; ix < x1; ++ix ) {
+					for ( int iy = by*QuantBlock; iy < y1; ++iy ) {
+						for ( int iz = bz*QuantBlock; iz < z1; ++iz ) {
+							float v = values[((size_t)ix*ny + iy)*nz + iz];
+							size_t idx = block * blockSize
+							           + ((ix % QuantBlock) * QuantBlock + iy % QuantBlock) * QuantBlock
+							           + iz % QuantBlock;
+							if ( !(v >= 0) ) {
+								codes[idx] = QuantInvalid;
+								continue;
+							}
+
+							long code = scale > 0 ? lround((v - vmin) / scale) : 0;
+							if ( code > QuantInvalid - 1 ) code = QuantInvalid - 1;
+							codes[idx] = (uint16_t)code;
+
+							// Same arithmetic as the reader
+							float decoded = vmin + (float)codes[idx] * scale;
+							maxError = max(maxError, (double)fabs(decoded - v));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	string tmp = target + ".tmp";
+	ofstream out(tmp.c_str(), ios::binary | ios::trunc);
+	if ( !out.is_open() ) return -1;
+
+	int32_t dims[4] = { nx, ny, nz, QuantBlock };
+	out.write(QuantMagic, strlen(QuantMagic));
+	out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+	out.write(reinterpret_cast<const char*>(&offsets[0]), nblock * sizeof(float));
+	out.write(reinterpret_cast<const char*>(&scales[0]), nblock * sizeof(float));
+	out.write(reinterpret_cast<const char*>(&codes[0]), codes.size() * sizeof(uint16_t));
+	out.close();
+
+	if ( !out || rename(tmp.c_str(), target.c_str()) != 0 ) {
+		unlink(tmp.c_str());
+		return -1;
+	}
+
+	return maxError;
+}
+
+
+size_t fileSize(const string &path) {
+	struct stat st;
+	if ( stat(path.c_str(), &st) != 0 ) return 0;
+	return (size_t)st.st_size;
+}
+
+
+}
+
+
+class NLLGridCacheApp : public Client::Application {
+	public:
+		NLLGridCacheApp(int argc, char **argv) : Client::Application(argc, argv) {
+			setMessagingEnabled(false);
+			setDatabaseEnabled(false, false);
+			setLoggingToStdErr(true);
+		}
+
+	protected:
+		void createCommandLineDescription() {
+			commandline().addGroup("Commands");
+			commandline().addOption("Commands", "preload", "copy the travel time grids of the selected profiles into the cache directory");
+			commandline().addOption("Commands", "evict", "remove the travel time grids of the selected profiles from the cache directory");
+			commandline().addOption("Commands", "list", "list the cache state of the selected profiles");
+			commandline().addGroup("Options");
+			commandline().addOption("Options", "profile", "NonLinLoc profile to process, all configured profiles if not given", &_profile);
+			commandline().addOption("Options", "cache-dir", "cache directory, overrides NonLinLoc.gridCacheDir", &_cacheDir);
+			commandline().addOption("Options", "quantize", "with --preload: store the travel time grids quantised to 16 bit");
+			commandline().addOption("Options", "swap-bytes", "with --quantize: swap the byte order of the original grids");
+		}
+
+		bool validateParameters() {
+			if ( !Client::Application::validateParameters() ) return false;
+
+			int commands = 0;
+			if ( commandline().hasOption("preload") ) ++commands;
+			if ( commandline().hasOption("evict") ) ++commands;
+			if ( commandline().hasOption("list") ) ++commands;
+
+			if ( commands != 1 ) {
+				cerr << "ERROR: exactly one of --preload, --evict or --list is required" << endl;
+				return false;
+			}
+
+			return true;
+		}
+
+		bool run() {
+			Environment *env = Environment::Instance();
+
+			if ( _cacheDir.empty() ) {
+				try { _cacheDir = env->absolutePath(configGetString("NonLinLoc.gridCacheDir")); }
+				catch ( ... ) {}
+			}
+
+			if ( _cacheDir.empty() ) {
+				cerr << "ERROR: no cache directory configured (NonLinLoc.gridCacheDir)" << endl;
+				return false;
+			}
+
+			while ( _cacheDir.size() > 1 && _cacheDir[_cacheDir.size()-1] == '/' )
+				_cacheDir.erase(_cacheDir.size()-1);
+
+			vector<string> profiles;
+			if ( !_profile.empty() )
+				profiles.push_back(_profile);
+			else {
+				try { profiles = configGetStrings("NonLinLoc.profiles"); }
+				catch ( ... ) {}
+			}
+
+			// Profiles may share the same tables
+			set<string> tables;
+			for ( size_t i = 0; i < profiles.size(); ++i ) {
+				string tablePath;
+				try {
+					tablePath = env->absolutePath(configGetString("NonLinLoc.profile." + profiles[i] + ".tablePath"));
+				}
+				catch ( ... ) {
+					cerr << "ERROR: profile " << profiles[i] << ": no tablePath configured" << endl;
+					return false;
+				}
+
+				tables.insert(tablePath);
+			}
+
+			if ( tables.empty() ) {
+				cerr << "ERROR: no profiles to process" << endl;
+				return false;
+			}
+
+			bool result = true;
+			for ( set<string>::iterator it = tables.begin(); it != tables.end(); ++it ) {
+				if ( commandline().hasOption("preload") )
+					result = preload(*it) && result;
+				else if ( commandline().hasOption("evict") )
+					result = evict(*it) && result;
+				else
+					list(*it);
+			}
+
+			return result;
+		}
+
+	private:
+		bool preload(const string &tablePath) {
+			vector<string> files = tableFiles(tablePath);
+			if ( files.empty() ) {
+				cerr << "ERROR: " << tablePath << ": no grid files found" << endl;
+				return false;
+			}
+
+			string targetDir = dirName(cachedTablePath(_cacheDir, tablePath));
+			if ( !Util::pathExists(targetDir) && !Util::createPath(targetDir) ) {
+				cerr << "ERROR: failed to create directory " << targetDir << endl;
+				return false;
+			}
+
+			// Disable a previously cached table before any of its files is
+			// replaced, otherwise the NonLinLoc plugin could read a mix of
+			// old and new grids. If anything fails the table stays
+			// disabled.
+			string marker = markerPath(_cacheDir, tablePath);
+			if ( Util::fileExists(marker) && unlink(marker.c_str()) != 0 ) {
+				cerr << "ERROR: failed to remove " << marker << endl;
+				return false;
+			}
+
+			bool quantize = commandline().hasOption("quantize");
+			double maxError = 0;
+			size_t bytes = 0;
+			for ( size_t i = 0; i < files.size(); ++i ) {
+				string source = dirName(tablePath) + "/" + files[i];
+				string target = targetDir + "/" + files[i];
+				// A quantised copy of a grid is stored as .qbuf which is
+				// only read if no .buf exists. The copy in the other
+				// format of a previous preload is removed after the new
+				// one has been written.
+				string stale;
+
+				int nx, ny, nz;
+				if ( quantize && endsWith(files[i], ".time.buf")
+				  && readGridDimensions(source.substr(0, source.size()-4) + ".hdr", nx, ny, nz) ) {
+					stale = target;
+					target = target.substr(0, target.size()-4) + ".qbuf";
+					double error = quantizeGrid(source, target, nx, ny, nz, commandline().hasOption("swap-bytes"));
+					if ( error < 0 ) {
+						cerr << "ERROR: failed to quantise " << source << " to " << target << endl;
+						return false;
+					}
+
+					maxError = max(maxError, error);
+				}
+				else {
+					if ( endsWith(files[i], ".buf") )
+						stale = target.substr(0, target.size()-4) + ".qbuf";
+
+					if ( !copyFile(source, target) ) {
+						cerr << "ERROR: failed to copy " << source << " to " << target << endl;
+						return false;
+					}
+				}
+
+				if ( !stale.empty() && Util::fileExists(stale) && unlink(stale.c_str()) != 0 ) {
+					cerr << "ERROR: failed to remove " << stale << endl;
+					return false;
+				}
+
+				bytes += fileSize(target);
+			}
+
+			// Enable the cached table for the NonLinLoc plugin only after
+			// all grids have been written. The marker is renamed into
+			// place so that it never exists partially written.
+			string tmpMarker = marker + ".tmp";
+			ofstream out(tmpMarker.c_str(), ios::trunc);
+			out << tablePath << endl;
+			out.close();
+			if ( !out || rename(tmpMarker.c_str(), marker.c_str()) != 0 ) {
+				unlink(tmpMarker.c_str());
+				cerr << "ERROR: failed to write " << marker << endl;
+				return false;
+			}
+
+			cout << tablePath << ": cached " << files.size() << " files, "
+			     << bytes / (1024*1024) << " MB";
+			if ( quantize )
+				cout << ", max. quantisation error " << maxError << " s";
+			cout << endl;
+
+			return true;
+		}
+
+		bool evict(const string &tablePath) {
+			// Disable the cached table first. Processes which have grids
+			// mapped keep them until they release them, the data is freed
+			// when the last mapping is gone.
+			string marker = markerPath(_cacheDir, tablePath);
+			if ( Util::fileExists(marker) && unlink(marker.c_str()) != 0 ) {
+				cerr << "ERROR: failed to remove " << marker << endl;
+				return false;
+			}
+
+			string cached = cachedTablePath(_cacheDir, tablePath);
+			vector<string> files = tableFiles(cached);
+			for ( size_t i = 0; i < files.size(); ++i ) {
+				string path = dirName(cached) + "/" + files[i];
+				if ( unlink(path.c_str()) != 0 ) {
+					cerr << "ERROR: failed to remove " << path << endl;
+					return false;
+				}
+			}
+
+			cout << tablePath << ": evicted " << files.size() << " files" << endl;
+
+			return true;
+		}
+
+		void list(const string &tablePath) {
+			string cached = cachedTablePath(_cacheDir, tablePath);
+			vector<string> files = tableFiles(cached);
+
+			size_t bytes = 0;
+			for ( size_t i = 0; i < files.size(); ++i )
+				bytes += fileSize(dirName(cached) + "/" + files[i]);
+
+			cout << tablePath << ": "
+			     << (Util::fileExists(markerPath(_cacheDir, tablePath)) ? "cached" : "not cached")
+			     << ", " << files.size() << " files, " << bytes / (1024*1024) << " MB" << endl;
+		}
+
+	private:
+		std::string _profile;
+		std::string _cacheDir;
+};
+
+
+int main(int argc, char **argv) {
+	int retCode = EXIT_SUCCESS;
+
+	// Create an own block to make sure the application object
+	// is destroyed when printing the overall objectcount
+	{
+		NLLGridCacheApp app(argc, argv);
+		retCode = app.exec();
+	}
+
+	return retCode;
+}
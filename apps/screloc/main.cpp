@@ -30,10 +30,23 @@
 #include <seiscomp/datamodel/publicobjectcache.h>
 #include <seiscomp/seismology/locatorinterface.h>
 #include <seiscomp/io/archive/xmlarchive.h>
+#include <seiscomp/utils/timer.h>
 
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 
 using namespace std;
@@ -83,11 +96,14 @@ class Reloc : public Client::Application {
 			                                            "by their relocated counterparts or just added to the output.");
 			commandline().addOption("Input", "drop-failure", "Used in combination with --replace/--ep and drops from the output "
 			                                            "the origins for which the relocation failed.");
+			commandline().addOption("Input", "workers", "Used in combination with --ep and defines the number of worker processes "
+			                                            "relocating origins concurrently, each with its own locator instance. "
+			                                            "0 uses the number of available CPUs.", &_workers, true);
 			commandline().addGroup("Output");
 			commandline().addOption("Output", "origin-id-suffix", "create origin ID from that of the input origin plus the specfied suffix", &_originIDSuffix);
 			commandline().addOption("Output", "evaluation-mode", "evaluation mode of the new origin (AUTOMATIC or MANUAL)", &_originEvaluationMode, true);
 			commandline().addGroup("Profiling");
-			commandline().addOption("Profiling", "measure-relocation-time", "measure and log the time it takes to run each relocation");
+			commandline().addOption("Profiling", "measure-relocation-time", "measure the time it takes to run each relocation and log statistics at exit");
 			commandline().addOption("Profiling", "repeated-relocations", "improve measurement of relocation time by running each relocation multiple times", &_repeatedRelocationCount);
 		}
 
@@ -158,6 +174,15 @@ class Reloc : public Client::Application {
 				_allowPreliminary = true;
 			}
 
+			if ( _workers < 0 ) {
+				SEISCOMP_ERROR("Invalid number of workers: %d", _workers);
+				return false;
+			}
+
+			if ( _workers == 0 ) {
+				_workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+			}
+
 			return true;
 		}
 
@@ -255,34 +280,42 @@ class Reloc : public Client::Application {
 					}
 				}
 
+				// select origins to be relocated
+				vector<bool> selected(numberOfOrigins, true);
+				if ( !_originIDs.empty() ) {
+					for ( int i = 0; i < numberOfOrigins; ++i ) {
+						selected[i] = find(_originIDs.begin(), _originIDs.end(),
+						                   ep->origin(i)->publicID()) != _originIDs.end();
+					}
+				}
+
+				Util::StopWatch timer;
+
+				// With multiple workers all selected origins are relocated
+				// upfront, the results are then added to the output in
+				// origin order as in sequential processing
+				vector<RelocationResult> results;
+				bool parallel = _workers > 1;
+				if ( parallel ) {
+					SEISCOMP_INFO("  + relocating with %d workers", _workers);
+					relocateConcurrently(ep.get(), selected, results);
+				}
+
 				int processed = 0, numRelocated = 0;
 				for ( int i = 0; i < numberOfOrigins; ++i, ++processed ) {
 					OriginPtr org = ep->origin(i);
 					std::string publicID = org->publicID();
 					SEISCOMP_DEBUG("Processing origin %s", publicID.c_str());
 
-					bool processing = true;
-					if ( !_originIDs.empty() ) {
-						processing = false;
-						for ( size_t i = 0; i < _originIDs.size(); ++i ) {
-							if ( publicID == _originIDs[i] ) {
-								processing = true;
-							}
-						}
-						if ( !processing ) {
-							SEISCOMP_DEBUG("  + skip origin, not in origin-id list");
-							continue;
-						}
+					if ( !selected[i] ) {
+						SEISCOMP_DEBUG("  + skip origin, not in origin-id list");
+						continue;
 					}
 
-					bool relocated;
-					try {
-						org = process(org.get());
-						relocated = true;
-					}
-					catch ( std::exception &e ) {
-						SEISCOMP_ERROR("  + processing failed - %s", e.what());
-						relocated = false;
+					RelocationResult result = parallel ? results[i] : relocate(org.get());
+					bool relocated = result.relocated;
+					if ( relocated ) {
+						org = result.origin;
 					}
 					if ( !org ) { // safety belt, but it should not happen
 						SEISCOMP_ERROR("  + processing failed %s", publicID.c_str());
@@ -323,8 +356,8 @@ class Reloc : public Client::Application {
 						SEISCOMP_INFO("  + processed %d origins", processed+1);
 					}
 				}
- 				SEISCOMP_INFO("  + processed %d origins, successfully relocated %d",
-				              processed, numRelocated);
+ 				SEISCOMP_INFO("  + processed %d origins, successfully relocated %d in %.3f s",
+				              processed, numRelocated, (double)timer.elapsed());
 
 				ar.create("-");
 				ar.setFormattedOutput(true);
@@ -389,6 +422,15 @@ class Reloc : public Client::Application {
 		}
 
 
+		void done() override {
+			if ( commandline().hasOption("measure-relocation-time") ) {
+				reportRelocationTimes();
+			}
+
+			Client::Application::done();
+		}
+
+
 	protected:
 		void handleMessage(Core::Message* msg) {
 			Application::handleMessage(msg);
@@ -485,12 +527,62 @@ class Reloc : public Client::Application {
 
 
 	private:
-		OriginPtr process(Origin *org) {
-			if ( org->arrivalCount() == 0 )
-				query()->loadArrivals(org);
+		struct RelocationResult {
+			OriginPtr origin;
+			bool      relocated{false};
+			double    seconds{0};
+		};
+
+		//! Header of a relocation result sent by a worker process, followed
+		//! by the relocated origin as XML
+		struct RelocationRecord {
+			int32_t  index;
+			int32_t  relocated;
+			double   seconds;
+			uint64_t size;
+		};
+
+
+		/**
+		 * @brief Loads all picks referenced by the arrivals of an origin
+		 * with a single database query if at least one of them is not yet
+		 * available. Otherwise each missing pick would be requested
+		 * separately through the cache.
+		 * @param org The origin
+		 */
+		void prefetchPicks(Origin *org) {
+			if ( !query() ) return;
+
+			bool missing = false;
+			for ( size_t i = 0; i < org->arrivalCount(); ++i ) {
+				if ( !Pick::Find(org->arrival(i)->pickID()) ) {
+					missing = true;
+					break;
+				}
+			}
+
+			if ( !missing ) return;
 
+			size_t count = 0;
+			DatabaseIterator it = query()->getPicks(org->publicID());
+			for ( ; *it; ++it ) {
+				Pick *pick = Pick::Cast(*it);
+				if ( pick ) {
+					_cache.feed(pick);
+					++count;
+				}
+			}
+			it.close();
+
+			SEISCOMP_DEBUG("  + prefetched %d picks", (int)count);
+		}
+
+
+		LocatorInterface::PickList collectPicks(Origin *org) {
 			LocatorInterface::PickList picks;
 
+			prefetchPicks(org);
+
 			// Load all referenced picks and store them locally. Through the
 			// global PublicObject pool they can then be found by the locator.
 			for ( size_t i = 0; i < org->arrivalCount(); ++i ) {
@@ -509,6 +601,270 @@ class Reloc : public Client::Application {
 				picks.push_back(pick.get());
 			}
 
+			return picks;
+		}
+
+
+		RelocationResult relocate(Origin *org) {
+			RelocationResult result;
+			_lastRelocationTime = 0;
+
+			try {
+				result.origin = process(org);
+				result.relocated = true;
+			}
+			catch ( std::exception &e ) {
+				SEISCOMP_ERROR("  + processing failed - %s", e.what());
+			}
+
+			result.seconds = _lastRelocationTime;
+			return result;
+		}
+
+
+		static bool writeAll(int fd, const char *data, size_t size) {
+			while ( size > 0 ) {
+				ssize_t written = ::write(fd, data, size);
+				if ( written < 0 ) {
+					if ( errno == EINTR ) continue;
+					return false;
+				}
+				data += written;
+				size -= written;
+			}
+
+			return true;
+		}
+
+
+		/**
+		 * @brief Relocates all selected origins of ep in _workers processes.
+		 * Locators, NonLinLoc in particular, keep global state. Each worker
+		 * is therefore a forked process with its own locator instance.
+		 * Origins are assigned to workers round-robin and the results are
+		 * sent back through one pipe per worker.
+		 * @param ep The event parameters
+		 * @param selected Flags of the origins to be relocated
+		 * @param results Relocation results indexed by origin
+		 */
+		void relocateConcurrently(EventParameters *ep, const vector<bool> &selected,
+		                          vector<RelocationResult> &results) {
+			int numberOfOrigins = (int)selected.size();
+			results.assign(numberOfOrigins, RelocationResult());
+
+			// Relocation resets the arrival weights of the input origins,
+			// apply this here as well so the output equals that of sequential
+			// processing
+			for ( int i = 0; i < numberOfOrigins; ++i ) {
+				if ( selected[i] ) {
+					collectPicks(ep->origin(i));
+				}
+			}
+
+			struct Worker {
+				pid_t  pid{-1};
+				int    fd{-1};
+				string buffer;
+			};
+
+			vector<Worker> workers(_workers);
+			vector<int> localShares;
+
+			cout.flush();
+			cerr.flush();
+
+			for ( int w = 0; w < _workers; ++w ) {
+				int fds[2];
+				if ( pipe(fds) != 0 ) {
+					SEISCOMP_ERROR("Failed to create pipe for worker %d: %s, relocating its "
+					               "origins in the main process", w, strerror(errno));
+					localShares.push_back(w);
+					continue;
+				}
+
+				// Pending C stdio output, e.g. of NonLinLoc, would otherwise
+				// be written by the worker again
+				fflush(NULL);
+				pid_t pid = fork();
+				if ( pid < 0 ) {
+					SEISCOMP_ERROR("Failed to start worker %d: %s, relocating its "
+					               "origins in the main process", w, strerror(errno));
+					::close(fds[0]);
+					::close(fds[1]);
+					localShares.push_back(w);
+					continue;
+				}
+
+				if ( pid == 0 ) {
+					// Worker process
+					::close(fds[0]);
+					for ( int j = 0; j < w; ++j ) {
+						if ( workers[j].fd >= 0 ) ::close(workers[j].fd);
+					}
+
+					int exitCode = EXIT_SUCCESS;
+					for ( int i = w; i < numberOfOrigins; i += _workers ) {
+						if ( !selected[i] ) continue;
+
+						SEISCOMP_DEBUG("Processing origin %s", ep->origin(i)->publicID().c_str());
+						RelocationResult result = relocate(ep->origin(i));
+
+						string data;
+						if ( result.relocated && result.origin ) {
+							stringbuf buf;
+							IO::XMLArchive ar;
+							if ( ar.create(&buf) ) {
+								ar << result.origin;
+								ar.close();
+								data = buf.str();
+							}
+						}
+
+						RelocationRecord record;
+						record.index = i;
+						record.relocated = !data.empty();
+						record.seconds = result.seconds;
+						record.size = data.size();
+
+						if ( !writeAll(fds[1], reinterpret_cast<const char*>(&record), sizeof(record))
+						  || !writeAll(fds[1], data.data(), data.size()) ) {
+							exitCode = EXIT_FAILURE;
+							break;
+						}
+					}
+
+					::close(fds[1]);
+					// Destroy the locator to write pending output, e.g. of
+					// the asynchronous NonLinLoc writer
+					_locator = nullptr;
+					// Leave without running destructors and exit handlers
+					// of the main process
+					_exit(exitCode);
+				}
+
+				::close(fds[1]);
+				workers[w].pid = pid;
+				workers[w].fd = fds[0];
+			}
+
+			// Collect results from all workers
+			vector<bool> received(numberOfOrigins, false);
+			int numReceived = 0;
+			while ( true ) {
+				vector<pollfd> pfds;
+				vector<Worker*> polled;
+				for ( auto &worker : workers ) {
+					if ( worker.fd < 0 ) continue;
+					pfds.push_back({worker.fd, POLLIN, 0});
+					polled.push_back(&worker);
+				}
+
+				if ( pfds.empty() ) break;
+
+				if ( poll(pfds.data(), pfds.size(), -1) < 0 ) {
+					if ( errno == EINTR ) continue;
+					SEISCOMP_ERROR("Failed to wait for workers: %s", strerror(errno));
+					break;
+				}
+
+				for ( size_t k = 0; k < pfds.size(); ++k ) {
+					if ( !pfds[k].revents ) continue;
+
+					Worker *worker = polled[k];
+					char chunk[65536];
+					ssize_t bytes = ::read(worker->fd, chunk, sizeof(chunk));
+					if ( bytes < 0 && errno == EINTR ) continue;
+					if ( bytes <= 0 ) {
+						::close(worker->fd);
+						worker->fd = -1;
+						continue;
+					}
+
+					worker->buffer.append(chunk, bytes);
+
+					// Extract all complete records
+					size_t pos = 0;
+					while ( worker->buffer.size() - pos >= sizeof(RelocationRecord) ) {
+						RelocationRecord record;
+						memcpy(&record, worker->buffer.data() + pos, sizeof(record));
+						if ( worker->buffer.size() - pos - sizeof(record) < record.size ) break;
+
+						RelocationResult &result = results[record.index];
+						received[record.index] = true;
+						result.seconds = record.seconds;
+						if ( record.relocated ) {
+							stringbuf buf(worker->buffer.substr(pos + sizeof(record), record.size));
+							IO::XMLArchive ar;
+							if ( ar.open(&buf) ) {
+								ar >> result.origin;
+								ar.close();
+							}
+							result.relocated = result.origin != nullptr;
+						}
+
+						if ( commandline().hasOption("measure-relocation-time") ) {
+							_relocationTimes.push_back(record.seconds);
+						}
+
+						pos += sizeof(record) + record.size;
+						if ( ((++numReceived) % 100) == 0 ) {
+							SEISCOMP_INFO("  + relocated %d origins", numReceived);
+						}
+					}
+
+					worker->buffer.erase(0, pos);
+				}
+			}
+
+			for ( int w = 0; w < _workers; ++w ) {
+				if ( workers[w].pid < 0 ) continue;
+
+				int status = 0;
+				while ( waitpid(workers[w].pid, &status, 0) < 0 && errno == EINTR ) {}
+				if ( !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS ) {
+					SEISCOMP_ERROR("Worker %d terminated abnormally, relocating its "
+					               "origins without result in the main process", w);
+					localShares.push_back(w);
+				}
+			}
+
+			// Relocate the shares of workers that could not be started or
+			// did not deliver all results
+			for ( int w : localShares ) {
+				for ( int i = w; i < numberOfOrigins; i += _workers ) {
+					if ( selected[i] && !received[i] ) {
+						results[i] = relocate(ep->origin(i));
+					}
+				}
+			}
+		}
+
+
+		void reportRelocationTimes() const {
+			if ( _relocationTimes.empty() ) return;
+
+			vector<double> times(_relocationTimes);
+			sort(times.begin(), times.end());
+
+			auto percentile = [&times](double p) {
+				return 1000. * times[static_cast<size_t>(p * (times.size() - 1) + 0.5)];
+			};
+
+			double total = accumulate(times.begin(), times.end(), 0.0);
+			SEISCOMP_INFO("Relocation time of %zu origins: total %.3f s, mean %.3f ms, "
+			              "min %.3f ms, median %.3f ms, 90%% %.3f ms, 99%% %.3f ms, max %.3f ms",
+			              times.size(), total, 1000. * total / times.size(),
+			              1000. * times.front(), percentile(0.5), percentile(0.9),
+			              percentile(0.99), 1000. * times.back());
+		}
+
+
+		OriginPtr process(Origin *org) {
+			if ( org->arrivalCount() == 0 )
+				query()->loadArrivals(org);
+
+			LocatorInterface::PickList picks = collectPicks(org);
+
 			_locator->useFixedDepth(false);
 
 			if ( _adoptFixedDepth ) {
@@ -532,6 +888,7 @@ class Reloc : public Client::Application {
 			for (size_t i=0; i<_repeatedRelocationCount; i++)
 				newOrg = _locator->relocate(org);
 			double seconds = (double) timer.elapsed() / _repeatedRelocationCount;
+			_lastRelocationTime = seconds;
 
 			if ( newOrg ) {
 				if ( _originEvaluationMode == "AUTOMATIC" ) {
@@ -567,8 +924,7 @@ class Reloc : public Client::Application {
 			}
 
 			if ( commandline().hasOption("measure-relocation-time") ) {
-				double milliseconds = 1000.*seconds;
-				SEISCOMP_DEBUG("  + time for relocating: %.3f ms", milliseconds);
+				_relocationTimes.push_back(seconds);
 			}
 
 			if ( commandline().hasOption("dump") ) {
@@ -637,6 +993,9 @@ class Reloc : public Client::Application {
 		std::string                _originEvaluationMode;
 		std::string                _epFile;
 		size_t                     _repeatedRelocationCount;
+		int                        _workers{1};
+		double                     _lastRelocationTime{0};
+		std::vector<double>        _relocationTimes;
 };
 
 
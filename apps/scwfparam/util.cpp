@@ -36,7 +36,9 @@
 */
 #include <seiscomp/core/system.h>
 
+#include <algorithm>
 #include <iomanip>
+#include <limits>
 
 
 using namespace std;
@@ -46,17 +48,205 @@ namespace Private {
 
 namespace {
 
-bool passes(const StringSet &ids, const std::string &id) {
-	StringSet::iterator it;
-	for ( it = ids.begin(); it != ids.end(); ++it ) {
-		if ( Core::wildcmp(*it, id) )
+// Parses the upper cased gain unit of a stream
+bool streamUnit(Processing::WaveformProcessor::SignalUnit &unit,
+                const DataModel::Stream *stream) {
+	string gainUnit = stream->gainUnit();
+	std::transform(gainUnit.begin(), gainUnit.end(), gainUnit.begin(), ::toupper);
+	return unit.fromString(gainUnit);
+}
+
+
+// Returns the sampling rate of a stream or -1 if not available
+double streamSamplingRate(const DataModel::Stream *stream) {
+	try {
+		if ( stream->sampleRateDenominator() == 0 )
+			return -1;
+		return stream->sampleRateNumerator() / stream->sampleRateDenominator();
+	}
+	catch ( Core::ValueException& ) {
+		return -1;
+	}
+}
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+WildcardSet::WildcardSet() {
+	clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WildcardSet::add(const std::string &pattern) {
+	if ( !_patterns.insert(pattern).second ) return;
+
+	int node = 0;
+
+	for ( size_t i = 0; i < pattern.size(); ++i ) {
+		char c = pattern[i];
+		int next;
+
+		if ( c == '*' ) {
+			next = _nodes[node].star;
+			if ( next < 0 ) {
+				next = (int)_nodes.size();
+				_nodes.push_back(Node());
+				_nodes[next].loop = true;
+				_nodes[node].star = next;
+			}
+		}
+		else if ( c == '?' ) {
+			next = _nodes[node].any;
+			if ( next < 0 ) {
+				next = (int)_nodes.size();
+				_nodes.push_back(Node());
+				_nodes[node].any = next;
+			}
+		}
+		else {
+			std::vector<Edge> &edges = _nodes[node].next;
+			std::vector<Edge>::iterator it = edges.begin();
+			while ( it != edges.end() && it->c < c ) ++it;
+
+			if ( it != edges.end() && it->c == c )
+				next = it->node;
+			else {
+				next = (int)_nodes.size();
+				Edge edge = { c, next };
+				edges.insert(it, edge);
+				_nodes.push_back(Node());
+			}
+		}
+
+		node = next;
+	}
+
+	_nodes[node].final = true;
+	_mark.assign(_nodes.size(), 0);
+	_generation = 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WildcardSet::clear() {
+	_patterns.clear();
+	_nodes.assign(1, Node());
+	_mark.assign(1, 0);
+	_generation = 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WildcardSet::activate(int node, std::vector<int> &active) const {
+	// '*' also matches the empty string, so the node behind it is active
+	// as well
+	while ( node >= 0 && _mark[node] != _generation ) {
+		_mark[node] = _generation;
+		active.push_back(node);
+		node = _nodes[node].star;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool WildcardSet::matches(const std::string &s) const {
+	if ( _patterns.size() < MinTriePatterns ) {
+		StringSet::const_iterator it;
+		for ( it = _patterns.begin(); it != _patterns.end(); ++it ) {
+			if ( Core::wildcmp(*it, s) )
+				return true;
+		}
+
+		return false;
+	}
+
+	// Node marks are compared against the generation, reset them before
+	// the counter overflows
+	if ( _generation > std::numeric_limits<int>::max() - (int)s.size() - 2 ) {
+		_mark.assign(_nodes.size(), 0);
+		_generation = 0;
+	}
+
+	_active.clear();
+	++_generation;
+	activate(0, _active);
+
+	for ( size_t i = 0; i < s.size() && !_active.empty(); ++i ) {
+		char c = s[i];
+
+		_nextActive.clear();
+		++_generation;
+
+		for ( size_t j = 0; j < _active.size(); ++j ) {
+			const Node &node = _nodes[_active[j]];
+
+			if ( node.loop )
+				activate(_active[j], _nextActive);
+
+			// Edges are sorted and usually few, a linear scan is fastest
+			for ( size_t k = 0; k < node.next.size(); ++k ) {
+				if ( node.next[k].c < c ) continue;
+				if ( node.next[k].c == c )
+					activate(node.next[k].node, _nextActive);
+				break;
+			}
+
+			if ( node.any >= 0 )
+				activate(node.any, _nextActive);
+		}
+
+		_active.swap(_nextActive);
+	}
+
+	for ( size_t j = 0; j < _active.size(); ++j ) {
+		if ( _nodes[_active[j]].final )
 			return true;
 	}
 
 	return false;
 }
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+StringFirewall::StringFirewall(const StringFirewall &other)
+: allow(other.allow), deny(other.deny) {}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
 
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+StringFirewall &StringFirewall::operator=(const StringFirewall &other) {
+	// The cache refers into itself and is not copied but rebuilt on demand
+	if ( this != &other ) {
+		allow = other.allow;
+		deny = other.deny;
+		cache.clear();
+		cacheUse.clear();
+	}
+
+	return *this;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -68,18 +258,31 @@ bool StringFirewall::isAllowed(const std::string &s) const {
 	// If no rules are configured, don't cache anything and just return true
 	if ( allow.empty() && deny.empty() ) return true;
 
-	StringPassMap::const_iterator it = cache.find(s);
+	StringPassMap::iterator it = cache.find(s);
 
 	// Not yet cached, evaluate the string
 	if ( it == cache.end() ) {
-		bool check = (allow.empty()?true:passes(allow, s))
-		          && (deny.empty()?true:!passes(deny, s));
-		cache[s] = check;
+		bool check = (allow.empty()?true:allow.matches(s))
+		          && (deny.empty()?true:!deny.matches(s));
+
+		// Keep the cache bounded, the least recently used string is
+		// dropped and just evaluated again if requested
+		if ( cache.size() >= MaxCacheSize ) {
+			StringPassMap::iterator lru = cacheUse.back();
+			cacheUse.pop_back();
+			cache.erase(lru);
+		}
+
+		it = cache.insert(StringPassMap::value_type(s, StringPassEntry())).first;
+		it->second.passed = check;
+		cacheUse.push_front(it);
+		it->second.use = cacheUse.begin();
 		return check;
 	}
 
-	// Return cached result
-	return it->second;
+	// Return cached result and mark it as most recently used
+	cacheUse.splice(cacheUse.begin(), cacheUse, it->second.use);
+	return it->second.passed;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -290,11 +493,7 @@ findStreamMaxSR(DataModel::Station *station, const Core::Time &time,
 
 			// Unable to retrieve the unit enumeration from string
 			//if ( !unit.fromString(sensor->unit().c_str()) ) continue;
-
-			string gainUnit = stream->gainUnit();
-			std::transform(gainUnit.begin(), gainUnit.end(), gainUnit.begin(), ::toupper);
-
-			if ( !unit.fromString(gainUnit) ) continue;
+			if ( !streamUnit(unit, stream) ) continue;
 			if ( unit != requestedUnit ) continue;
 
 			if ( firewall != NULL ) {
@@ -302,24 +501,110 @@ findStreamMaxSR(DataModel::Station *station, const Core::Time &time,
 				if ( firewall->isBlocked(streamID) ) continue;
 			}
 
-			try {
-				if ( stream->sampleRateDenominator() == 0 )  {
-					if ( res == NULL ) res = stream;
-					continue;
-				}
-				else {
-					double fsamp = stream->sampleRateNumerator() / stream->sampleRateDenominator();
-					if ( fsamp > fsampMax ) {
-						res = stream;
-						fsampMax = fsamp;
-						continue;
+			double fsamp = streamSamplingRate(stream);
+			if ( fsamp < 0 ) {
+				if ( res == NULL ) res = stream;
+			}
+			else if ( fsamp > fsampMax ) {
+				res = stream;
+				fsampMax = fsamp;
+			}
+		}
+	}
+
+	return res;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StreamIndex::build(const DataModel::Inventory *inv,
+                        const StringFirewall *firewall) {
+	clear();
+	inventory = inv;
+	if ( inventory == NULL ) return;
+
+	for ( size_t n = 0; n < inventory->networkCount(); ++n ) {
+		DataModel::Network *net = inventory->network(n);
+
+		for ( size_t s = 0; s < net->stationCount(); ++s ) {
+			DataModel::Station *station = net->station(s);
+			string stationID = net->code() + "." + station->code();
+			Candidates &candidates = stations[station];
+
+			for ( size_t i = 0; i < station->sensorLocationCount(); ++i ) {
+				DataModel::SensorLocation *loc = station->sensorLocation(i);
+				OPT(Core::Time) locEnd;
+
+				try { locEnd = loc->end(); }
+				catch ( Core::ValueException& ) {}
+
+				for ( size_t j = 0; j < loc->streamCount(); ++j ) {
+					DataModel::Stream *stream = loc->stream(j);
+					Candidate c;
+
+					if ( !streamUnit(c.unit, stream) ) continue;
+
+					if ( firewall != NULL ) {
+						string streamID = stationID + "." + loc->code() + "." + stream->code();
+						if ( firewall->isBlocked(streamID) ) continue;
+					}
+
+					c.stream = stream;
+					c.start = std::max(loc->start(), stream->start());
+					c.end = locEnd;
+					try {
+						if ( !c.end || stream->end() < *c.end )
+							c.end = stream->end();
 					}
+					catch ( Core::ValueException& ) {}
+					c.fsamp = streamSamplingRate(stream);
+
+					candidates.push_back(c);
 				}
 			}
-			catch ( Core::ValueException& ) {
-				if ( res == NULL ) res = stream;
-				continue;
-			}
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StreamIndex::clear() {
+	inventory = NULL;
+	stations.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+DataModel::Stream*
+StreamIndex::findStreamMaxSR(const DataModel::Station *station,
+                             const Core::Time &time,
+                             Processing::WaveformProcessor::SignalUnit requestedUnit) const {
+	StationCandidates::const_iterator it = stations.find(station);
+	if ( it == stations.end() ) return NULL;
+
+	DataModel::Stream *res = NULL;
+	double fsampMax = 0.0;
+
+	for ( Candidates::const_iterator c = it->second.begin(); c != it->second.end(); ++c ) {
+		if ( c->unit != requestedUnit ) continue;
+		if ( c->start > time ) continue;
+		if ( c->end && *c->end <= time ) continue;
+
+		if ( c->fsamp < 0 ) {
+			if ( res == NULL ) res = c->stream;
+		}
+		else if ( c->fsamp > fsampMax ) {
+			res = c->stream;
+			fsampMax = c->fsamp;
 		}
 	}
 
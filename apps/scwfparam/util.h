@@ -24,7 +24,11 @@
 #include <seiscomp/datamodel/inventory_package.h>
 #include <seiscomp/processing/waveformprocessor.h>
 #include "processors/pgav.h"
+#include <list>
+#include <map>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 
 namespace Seiscomp {
@@ -82,12 +86,83 @@ namespace Private {
 
 
 typedef std::set<std::string> StringSet;
-typedef std::map<std::string, bool> StringPassMap;
+// Cached result of each string with its position in the use list which
+// holds the cached strings, most recently used first
+struct StringPassEntry;
+typedef std::unordered_map<std::string, StringPassEntry> StringPassMap;
+typedef std::list<StringPassMap::iterator> StringUseList;
+
+struct StringPassEntry {
+	bool                    passed;
+	StringUseList::iterator use;
+};
+
+/**
+ * Set of wildcard patterns ('*' and '?', same semantics as Core::wildcmp)
+ * compiled into a trie. A string is matched against all patterns in a
+ * single pass by tracking the set of active trie nodes. Small sets are
+ * matched pattern by pattern with Core::wildcmp which is faster there.
+ */
+class WildcardSet {
+	public:
+		//! Minimum number of patterns for which the trie is used
+		static const size_t MinTriePatterns = 16;
+
+	public:
+		WildcardSet();
+
+	public:
+		void add(const std::string &pattern);
+		void clear();
+
+		bool empty() const { return _patterns.empty(); }
+		const StringSet &patterns() const { return _patterns; }
+
+		//! Returns true if any pattern matches the whole string
+		bool matches(const std::string &s) const;
+
+	private:
+		struct Edge {
+			char c;
+			int  node;
+		};
+
+		struct Node {
+			Node() : any(-1), star(-1), loop(false), final(false) {}
+
+			std::vector<Edge>   next; // literal transitions, sorted by char
+			int                 any;  // '?' transition
+			int                 star; // '*' transition
+			bool                loop; // node reached by '*', consumes any char
+			bool                final;
+		};
+
+		void activate(int node, std::vector<int> &active) const;
+
+		StringSet                 _patterns;
+		std::vector<Node>         _nodes;
+		// Scratch state sets and node marks of matches
+		mutable std::vector<int>  _active;
+		mutable std::vector<int>  _nextActive;
+		mutable std::vector<int>  _mark;
+		mutable int               _generation;
+};
+
 
 struct StringFirewall {
-	StringSet allow;
-	StringSet deny;
+	//! Maximum number of cached results, the least recently used result
+	//! is dropped if exceeded
+	static const size_t MaxCacheSize = 100000;
+
+	StringFirewall() {}
+	//! Copies the rules only, the cache of the copy starts empty
+	StringFirewall(const StringFirewall &other);
+	StringFirewall &operator=(const StringFirewall &other);
+
+	WildcardSet allow;
+	WildcardSet deny;
 	mutable StringPassMap cache;
+	mutable StringUseList cacheUse;
 
 	bool isAllowed(const std::string &s) const;
 	bool isBlocked(const std::string &s) const;
@@ -127,6 +202,42 @@ findStreamMaxSR(DataModel::Station *station, const Core::Time &time,
                 const StringFirewall *firewall);
 
 
+/**
+ * Channel selection index built once per inventory. For each station it
+ * holds the streams with a known gain unit which pass the firewall, in
+ * inventory order, together with the combined sensor location and stream
+ * epoch and the sampling rate. findStreamMaxSR then only checks the epoch
+ * and compares sampling rates of the candidates.
+ */
+struct StreamIndex {
+	struct Candidate {
+		DataModel::Stream                          *stream;
+		Processing::WaveformProcessor::SignalUnit   unit;
+		Core::Time                                  start;
+		OPT(Core::Time)                             end;
+		// Sampling rate, negative if not available
+		double                                      fsamp;
+	};
+
+	typedef std::vector<Candidate> Candidates;
+	typedef std::map<const DataModel::Station*, Candidates> StationCandidates;
+
+	const DataModel::Inventory *inventory;
+	StationCandidates           stations;
+
+	StreamIndex() : inventory(NULL) {}
+
+	void build(const DataModel::Inventory *inv, const StringFirewall *firewall);
+	void clear();
+
+	//! Returns the same stream as Private::findStreamMaxSR with the
+	//! firewall passed to build.
+	DataModel::Stream *
+	findStreamMaxSR(const DataModel::Station *station, const Core::Time &time,
+	                Processing::WaveformProcessor::SignalUnit requestedUnit) const;
+};
+
+
 }
 }
 
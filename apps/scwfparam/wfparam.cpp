@@ -794,7 +794,7 @@ bool WFParam::init() {
 		if ( !_config.streamsWhiteList[i].empty() ) {
 			SEISCOMP_DEBUG("Adding pattern to stream whitelist: %s",
 			               _config.streamsWhiteList[i].c_str());
-			_streamFirewall.allow.insert(_config.streamsWhiteList[i]);
+			_streamFirewall.allow.add(_config.streamsWhiteList[i]);
 		}
 	}
 
@@ -803,7 +803,7 @@ bool WFParam::init() {
 		if ( !_config.streamsBlackList[i].empty() ) {
 			SEISCOMP_DEBUG("Adding pattern to stream blacklist: %s",
 			               _config.streamsBlackList[i].c_str());
-			_streamFirewall.deny.insert(_config.streamsBlackList[i]);
+			_streamFirewall.deny.add(_config.streamsBlackList[i]);
 		}
 	}
 
@@ -1354,6 +1354,11 @@ void WFParam::process(Origin *origin) {
 		return;
 	}
 
+	// Channel selection depends on inventory and firewall only, build it
+	// once per inventory
+	if ( _streamIndex.inventory != inventory )
+		_streamIndex.build(inventory, &_streamFirewall);
+
 	// Clear all processors
 	_processors.clear();
 
@@ -1510,12 +1515,10 @@ void WFParam::process(Origin *origin) {
 			DataModel::WaveformStreamID tmp(net->code(), sta->code(), "", "", "");
 
 			DataModel::Stream *maxVel, *maxAcc;
-			maxVel = Private::findStreamMaxSR(sta, triggerTime,
-			                                  WaveformProcessor::MeterPerSecond,
-			                                  &_streamFirewall);
-			maxAcc = Private::findStreamMaxSR(sta, triggerTime,
-			                                  WaveformProcessor::MeterPerSecondSquared,
-			                                  &_streamFirewall);
+			maxVel = _streamIndex.findStreamMaxSR(sta, triggerTime,
+			                                      WaveformProcessor::MeterPerSecond);
+			maxAcc = _streamIndex.findStreamMaxSR(sta, triggerTime,
+			                                      WaveformProcessor::MeterPerSecondSquared);
 
 			/*
 			if ( maxVel && _currentProcess->hasBeenProcessed(maxVel) ) {
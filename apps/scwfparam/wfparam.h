@@ -290,6 +290,7 @@ class WFParam : public Application {
 
 		StreamMap                  _streams;
 		Private::StringFirewall    _streamFirewall;
+		Private::StreamIndex       _streamIndex;
 
 		TravelTimeTable            _travelTime;
 		ProcessorMap               _processors;
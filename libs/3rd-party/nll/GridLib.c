@@ -875,6 +875,140 @@ void setCascadingGrid(GridDesc* pgrid) {
 
 }
 
+/** function to determine if a grid is read from a quantised grid buffer file */
+
+int isQuantisedGrid(GridDesc* pgrid) {
+
+    return (pgrid->flagGridQuantised == IS_QUANTISED);
+
+}
+
+/** function to get number of blocks of a quantised grid along each axis */
+
+static long QuantisedGridNumBlocks(GridDesc* pgrid, int* pnbx, int* pnby, int* pnbz) {
+
+    *pnbx = (pgrid->numx + GRID_QUANT_BLOCK - 1) / GRID_QUANT_BLOCK;
+    *pnby = (pgrid->numy + GRID_QUANT_BLOCK - 1) / GRID_QUANT_BLOCK;
+    *pnbz = (pgrid->numz + GRID_QUANT_BLOCK - 1) / GRID_QUANT_BLOCK;
+
+    return ((long) *pnbx * (long) *pnby * (long) *pnbz);
+}
+
+/** function to get size in bytes of buffer of a quantised grid (block offsets, scales and codes) */
+
+size_t QuantisedGridBufferSize(GridDesc* pgrid) {
+
+    int nbx, nby, nbz;
+    long nblock = QuantisedGridNumBlocks(pgrid, &nbx, &nby, &nbz);
+
+    return ((size_t) nblock * (2 * sizeof (float)
+            + GRID_QUANT_BLOCK * GRID_QUANT_BLOCK * GRID_QUANT_BLOCK * sizeof (unsigned short)));
+}
+
+/** function to reverse byte order of n values of size nbytes */
+
+static void swapBytesN(void* buffer, long n, int nbytes) {
+
+    char *pos, *end, ctmp;
+    int i;
+
+    end = (char *) buffer + n * nbytes;
+    for (pos = (char *) buffer; pos < end; pos += nbytes) {
+        for (i = 0; i < nbytes / 2; i++) {
+            ctmp = pos[i];
+            pos[i] = pos[nbytes - 1 - i];
+            pos[nbytes - 1 - i] = ctmp;
+        }
+    }
+}
+
+/** function to read and check header of quantised grid buffer file, sets byte order of grid */
+
+static int ReadGrid3dHdr_Quantised(FILE* fpgrid, GridDesc* pgrid, char* fname) {
+
+    char magic[8];
+    int dims[4];
+
+    if (fread(magic, sizeof (magic), 1, fpgrid) != 1 || memcmp(magic, GRID_QUANT_MAGIC, sizeof (magic)) != 0
+            || fread(dims, sizeof (dims), 1, fpgrid) != 1) {
+        nll_puterr2("ERROR: invalid quantised grid buffer file", fname);
+        return (-1);
+    }
+
+    /* block size identifies byte order of writer */
+    pgrid->iSwapBytes = 0;
+    if (dims[3] != GRID_QUANT_BLOCK) {
+        swapBytesN(dims, 4, sizeof (int));
+        pgrid->iSwapBytes = 1;
+    }
+
+    if (dims[3] != GRID_QUANT_BLOCK
+            || dims[0] != pgrid->numx || dims[1] != pgrid->numy || dims[2] != pgrid->numz) {
+        nll_puterr2("ERROR: quantised grid buffer file does not match grid header", fname);
+        return (-1);
+    }
+
+    return (0);
+}
+
+/** function to read value of quantised grid from disk or buffer at index location */
+
+static GRID_FLOAT_TYPE ReadGrid3dValue_Quantised(FILE *fpgrid, int ix, int iy, int iz, GridDesc * pgrid) {
+
+    int nbx, nby, nbz;
+    long nblock, iblock, icode;
+    float offset, scale;
+    unsigned short code;
+    float *fbuffer;
+
+    if (ix < 0 || ix >= pgrid->numx || iy < 0 || iy >= pgrid->numy
+            || iz < 0 || iz >= pgrid->numz)
+        return (-VERY_LARGE_FLOAT);
+
+    nblock = QuantisedGridNumBlocks(pgrid, &nbx, &nby, &nbz);
+    iblock = ((long) (ix / GRID_QUANT_BLOCK) * nby + iy / GRID_QUANT_BLOCK) * nbz + iz / GRID_QUANT_BLOCK;
+    icode = iblock * GRID_QUANT_BLOCK * GRID_QUANT_BLOCK * GRID_QUANT_BLOCK
+            + ((ix % GRID_QUANT_BLOCK) * GRID_QUANT_BLOCK + iy % GRID_QUANT_BLOCK) * GRID_QUANT_BLOCK + iz % GRID_QUANT_BLOCK;
+
+    if (fpgrid != NULL) {
+        /* read code, then block offset and scale */
+        fseek(fpgrid, (long) GRID_QUANT_HDR_SIZE + 2 * nblock * (long) sizeof (float) + icode * (long) sizeof (unsigned short), SEEK_SET);
+        if (fread(&code, sizeof (unsigned short), 1, fpgrid) != 1) {
+            sprintf(MsgStr,
+                    "ERROR: reading grid value: %s: ix%d iy=%d iz=%d", pgrid->title, ix, iy, iz);
+            nll_puterr(MsgStr);
+            return (-VERY_LARGE_FLOAT);
+        }
+        if (pgrid->iSwapBytes)
+            swapBytesN(&code, 1, sizeof (unsigned short));
+        if (code == GRID_QUANT_INVALID)
+            return (-VERY_LARGE_FLOAT);
+        fseek(fpgrid, (long) GRID_QUANT_HDR_SIZE + iblock * (long) sizeof (float), SEEK_SET);
+        if (fread(&offset, sizeof (float), 1, fpgrid) != 1) {
+            nll_puterr2("ERROR: reading quantised grid block offset", pgrid->title);
+            return (-VERY_LARGE_FLOAT);
+        }
+        fseek(fpgrid, (long) GRID_QUANT_HDR_SIZE + (nblock + iblock) * (long) sizeof (float), SEEK_SET);
+        if (fread(&scale, sizeof (float), 1, fpgrid) != 1) {
+            nll_puterr2("ERROR: reading quantised grid block scale", pgrid->title);
+            return (-VERY_LARGE_FLOAT);
+        }
+        if (pgrid->iSwapBytes) {
+            swapBytesN(&offset, 1, sizeof (float));
+            swapBytesN(&scale, 1, sizeof (float));
+        }
+    } else {
+        fbuffer = (float *) pgrid->buffer;
+        code = ((unsigned short *) (fbuffer + 2 * nblock))[icode];
+        if (code == GRID_QUANT_INVALID)
+            return (-VERY_LARGE_FLOAT);
+        offset = fbuffer[iblock];
+        scale = fbuffer[nblock + iblock];
+    }
+
+    return ((GRID_FLOAT_TYPE) (offset + (float) code * scale));
+}
+
 /** function to write grid buffer and header to disk ***/
 
 int WriteGrid3dBuf(GridDesc* pgrid, SourceDesc* psrce, char* filename, char* file_type) {
@@ -937,6 +1071,18 @@ int WriteGrid3dHdr(GridDesc* pgrid, SourceDesc* psrce,
     }
     NumFilesOpen++;
 
+    WriteGrid3dHdrStream(fpio, pgrid, psrce);
+
+    fclose(fpio);
+    NumFilesOpen--;
+
+    return (0);
+}
+
+/** function to write 3D grid header to an open stream */
+
+int WriteGrid3dHdrStream(FILE* fpio, GridDesc* pgrid, SourceDesc* psrce) {
+
     fprintf(fpio, "%d %d %d  %lf %lf %lf  %lf %lf %lf %s",
             pgrid->numx, pgrid->numy, pgrid->numz,
             pgrid->origx, pgrid->origy, pgrid->origz,
@@ -966,11 +1112,7 @@ int WriteGrid3dHdr(GridDesc* pgrid, SourceDesc* psrce,
     }
     fprintf(fpio, "\n");
 
-
-    fclose(fpio);
-    NumFilesOpen--;
-
-    return (0);
+    return (ferror(fpio) ? -1 : 0);
 }
 
 //#define DEBUG_CASC
@@ -1155,7 +1297,10 @@ void* AllocateGrid(GridDesc * pgrid) {
         return (pgrid->buffer);
     }
 
-    pgrid->buffer_size = (size_t) (pgrid->numx * pgrid->numy * pgrid->numz * sizeof (GRID_FLOAT_TYPE));
+    if (isQuantisedGrid(pgrid))
+        pgrid->buffer_size = QuantisedGridBufferSize(pgrid);
+    else
+        pgrid->buffer_size = (size_t) (pgrid->numx * pgrid->numy * pgrid->numz * sizeof (GRID_FLOAT_TYPE));
     pgrid->buffer = (void *) malloc(pgrid->buffer_size);
     if (pgrid->buffer != NULL)
         NumAllocations++;
@@ -1239,7 +1384,11 @@ void*** CreateGridArray(GridDesc * pgrid) {
             return (NULL);
         NumAllocations++;
         for (iy = 0; iy < pgrid->numy; iy++) {
-            garray[ix][iy] = (GRID_FLOAT_TYPE *) pgrid->buffer + ix * numyz + iy * pgrid->numz;
+            // quantised grid buffer values cannot be accessed as floats
+            if (isQuantisedGrid(pgrid))
+                garray[ix][iy] = NULL;
+            else
+                garray[ix][iy] = (GRID_FLOAT_TYPE *) pgrid->buffer + ix * numyz + iy * pgrid->numz;
         }
     }
 
@@ -1280,6 +1429,7 @@ void DuplicateGrid(GridDesc* pnew_grid, GridDesc* pold_grid, char *new_chr_type)
 
     /* copy grid description */
     *pnew_grid = *pold_grid;
+    pnew_grid->flagGridQuantised = IS_NOT_QUANTISED;
 
     /* set grid type */
     strcpy(pnew_grid->chr_type, new_chr_type);
@@ -1758,6 +1908,39 @@ double GetEpiDist(SourceDesc* psrce, double xval, double yval) {
     }
 }
 
+/** function to calculate epicentral (horizontal) distances from sources to an x-y position,
+ *  sources given as arrays of x and y, same as GetEpiDist() for each source */
+
+void GetEpiDistArray(double xval, double yval, double* xsrce, double* ysrce, double* dist, int num) {
+
+    int n;
+    double xtmp, ytmp;
+    double lat1, lon1, sin_lat1, cos_lat1, lat2, d;
+
+    if (GeometryMode == MODE_GLOBAL) {
+        // same as GCDistance(), with trigonometric functions of x-y position evaluated once
+        lat1 = yval * DE2RA;
+        lon1 = xval * DE2RA;
+        sin_lat1 = sin(lat1);
+        cos_lat1 = cos(lat1);
+        for (n = 0; n < num; n++) {
+            if (yval == ysrce[n] && xval == xsrce[n]) {
+                dist[n] = 0.0;
+                continue;
+            }
+            lat2 = ysrce[n] * DE2RA;
+            d = sin_lat1 * sin(lat2) + cos_lat1 * cos(lat2) * cos(lon1 - xsrce[n] * DE2RA);
+            dist[n] = AVG_ERAD * acos(d);
+        }
+    } else {
+        for (n = 0; n < num; n++) {
+            xtmp = xval - xsrce[n];
+            ytmp = yval - ysrce[n];
+            dist[n] = sqrt(xtmp * xtmp + ytmp * ytmp);
+        }
+    }
+}
+
 /** function to calculate epicentral (horizontal) distance from a station to an x-y position */
 
 double GetEpiDistSta(StationDesc* psta, double xval, double yval) {
@@ -2044,6 +2227,9 @@ int ReadGrid3dBuf(GridDesc* pgrid, FILE * fpio) {
 
     /* read from grid file to buffer */
 
+    if (isQuantisedGrid(pgrid))
+        fseek(fpio, (long) GRID_QUANT_HDR_SIZE, SEEK_SET);
+
     int ireturn;
     if ((ireturn = fread((char *) pgrid->buffer, readsize, 1, fpio)) != 1) {
         printf("DEBUG: pgrid->buffer %ld, readsize %ld, fpio %ld, ireturn %d\n", (long) pgrid->buffer, readsize, (long) fpio, ireturn);
@@ -2051,8 +2237,17 @@ int ReadGrid3dBuf(GridDesc* pgrid, FILE * fpio) {
         return (-1);
     }
 
-    if (pgrid->iSwapBytes)
-        swapBytes(pgrid->buffer, readsize / sizeof (float));
+    if (pgrid->iSwapBytes) {
+        if (isQuantisedGrid(pgrid)) {
+            int nbx, nby, nbz;
+            long nblock = QuantisedGridNumBlocks(pgrid, &nbx, &nby, &nbz);
+            swapBytesN(pgrid->buffer, 2 * nblock, sizeof (float));
+            swapBytesN((float *) pgrid->buffer + 2 * nblock,
+                    (readsize - 2 * nblock * sizeof (float)) / sizeof (unsigned short), sizeof (unsigned short));
+        } else {
+            swapBytes(pgrid->buffer, readsize / sizeof (float));
+        }
+    }
 
     return (0);
 }
@@ -2076,6 +2271,15 @@ int ReadGrid3dBufSheet(GRID_FLOAT_TYPE* sheetbuf, GridDesc* pgrid_disk,
     }
 
 
+    if (isQuantisedGrid(pgrid_disk)) {
+        int iy, iz;
+        for (iy = 0; iy < pgrid_disk->numy; iy++)
+            for (iz = 0; iz < pgrid_disk->numz; iz++)
+                *sheetbuf++ = ReadGrid3dValue_Quantised(fpio, ix, iy, iz, pgrid_disk);
+        return (0);
+    }
+
+
     /* calculate offset in bytes */
 
     offset = sizeof (GRID_FLOAT_TYPE) * (ix * (pgrid_disk->numy * pgrid_disk->numz));
@@ -2146,6 +2350,9 @@ int ReadGrid3dHdr(GridDesc* pgrid, SourceDesc* psrce, char* filename, char* file
         }
     }
 
+    // grid buffer is not opened
+    pgrid->flagGridQuantised = IS_NOT_QUANTISED;
+
     // check if cascading grid
     pgrid->flagGridCascading = IS_NOT_CASCADING;
     int num_z_merge_depths;
@@ -2220,6 +2427,7 @@ int OpenGrid3dFile(char *fname, FILE **fp_grid, FILE **fp_hdr,
         GridDesc* pgrid, char* file_type, SourceDesc* psrce, int iSwapBytes) {
 
     char fn_grid[FILENAME_MAX], fn_hdr[FILENAME_MAX];
+    int quantised = 0;
 
     /* open grid file and header file */
 
@@ -2228,7 +2436,16 @@ int OpenGrid3dFile(char *fname, FILE **fp_grid, FILE **fp_hdr,
         sprintf(MsgStr, "Opening Grid File: %s", fn_grid);
         nll_putmsg(3, MsgStr);
     }
-    if ((*fp_grid = fopen(fn_grid, "r")) == NULL) {
+    *fp_grid = fopen(fn_grid, "r");
+    if (*fp_grid == NULL) {
+        /* try quantised grid buffer file */
+        sprintf(fn_grid, "%s.qbuf", fname);
+        if ((*fp_grid = fopen(fn_grid, "r")) != NULL)
+            quantised = 1;
+        else
+            sprintf(fn_grid, "%s.buf", fname);
+    }
+    if (*fp_grid == NULL) {
         if (message_flag >= 3) {
             sprintf(MsgStr, "WARNING: cannot open grid buffer file: %s", fn_grid);
             nll_putmsg(3, MsgStr);
@@ -2279,6 +2496,16 @@ int OpenGrid3dFile(char *fname, FILE **fp_grid, FILE **fp_hdr,
     if (pgrid->numx == 1)
         pgrid->dx = 1.0;
 
+    // check quantised grid buffer file
+    pgrid->flagGridQuantised = IS_NOT_QUANTISED;
+    if (quantised) {
+        if (ReadGrid3dHdr_Quantised(*fp_grid, pgrid, fn_grid) < 0) {
+            CloseGrid3dFile(pgrid, fp_grid, fp_hdr);
+            return (-1);
+        }
+        pgrid->flagGridQuantised = IS_QUANTISED;
+    }
+
 
     convert_grid_type(pgrid, 1);
     if (message_flag >= 4)
@@ -2338,6 +2565,12 @@ int OpenGrid3dFile(char *fname, FILE **fp_grid, FILE **fp_hdr,
         }
     }
 
+    if (isQuantisedGrid(pgrid) && isCascadingGrid(pgrid)) {
+        nll_puterr2("ERROR: quantised grid buffer files are not supported for cascading grids", fn_grid);
+        CloseGrid3dFile(pgrid, fp_grid, fp_hdr);
+        return (-1);
+    }
+
 
 
     return (0);
@@ -2742,6 +2975,9 @@ GRID_FLOAT_TYPE ReadGrid3dValue(FILE *fpgrid, int ix, int iy, int iz, GridDesc *
         return (ReadGrid3dValue_Cascading_Interp(fpgrid, (double) ix, (double) iy, (double) iz, pgrid, clean_casc_allocs));
     }
 
+    if (isQuantisedGrid(pgrid))
+        return (ReadGrid3dValue_Quantised(fpgrid, ix, iy, iz, pgrid));
+
 
     int numyz;
     long offset;
@@ -3029,7 +3265,7 @@ GRID_FLOAT_TYPE ReadAbsInterpGrid3d(FILE *fpgrid, GridDesc* pgrid, double xloc,
     /* location at grid node */
 
     if (xdiff + ydiff + zdiff < SMALL_FLOAT) {
-        if (fpgrid != NULL)
+        if (fpgrid != NULL || isQuantisedGrid(pgrid))
             value = ReadGrid3dValue(fpgrid, ix0, iy0, iz0, pgrid, 0);
         else
             value = *(buffer + ix0 * numyz + iy0 * numz + iz0);
@@ -3039,7 +3275,7 @@ GRID_FLOAT_TYPE ReadAbsInterpGrid3d(FILE *fpgrid, GridDesc* pgrid, double xloc,
 
     /* read vertex values from grid file or array */
 
-    if (fpgrid != NULL) {
+    if (fpgrid != NULL || isQuantisedGrid(pgrid)) {
         vval000 = ReadGrid3dValue(fpgrid, ix0, iy0, iz0, pgrid, 0);
         vval001 = ReadGrid3dValue(fpgrid, ix0, iy0, iz1, pgrid, 0);
         vval010 = ReadGrid3dValue(fpgrid, ix0, iy1, iz0, pgrid, 0);
@@ -3096,6 +3332,122 @@ GRID_FLOAT_TYPE ReadAbsInterpGrid3d(FILE *fpgrid, GridDesc* pgrid, double xloc,
 }
 
 
+/** function to check if two 3D grids have identical geometry and type */
+
+static int isSameGrid3dGeometry(GridDesc* pgrid1, GridDesc* pgrid2) {
+
+    return (pgrid1->type == pgrid2->type
+            && pgrid1->numx == pgrid2->numx && pgrid1->numy == pgrid2->numy && pgrid1->numz == pgrid2->numz
+            && pgrid1->origx == pgrid2->origx && pgrid1->origy == pgrid2->origy && pgrid1->origz == pgrid2->origz
+            && pgrid1->dx == pgrid2->dx && pgrid1->dy == pgrid2->dy && pgrid1->dz == pgrid2->dz);
+}
+
+/** function to read data from several 3D grid buffers at the same absolute location with interpolation ***/
+
+/* gives values identical to ReadAbsInterpGrid3d(NULL, pgrid[n], xloc, yloc, zloc, 0) for each grid,
+ * but cell indices and interpolation weights are calculated once for each sequence of grids with identical geometry,
+ * and interpolation is done for all grids of a sequence together
+ * grids must be in memory (buffer != NULL), not cascading, not quantised and not angle grids */
+
+void ReadAbsInterpGrid3dBatch(GridDesc** pgrid, int ngrid, double xloc, double yloc, double zloc, GRID_FLOAT_TYPE *values) {
+
+    int nstart, nend, n, k;
+    int ix0, ix1, iy0, iy1, iz0, iz1;
+    int numyz, numz;
+    int offset[8];
+    DOUBLE xoff, yoff, zoff;
+    DOUBLE xdiff, ydiff, zdiff;
+    DOUBLE oneMinusXdiff, oneMinusYdiff, oneMinusZdiff;
+    DOUBLE vval[8][GRID_INTERP_BATCH_SIZE];
+    GridDesc* pgrid_ref;
+    GRID_FLOAT_TYPE *buffer;
+
+    for (nstart = 0; nstart < ngrid; nstart = nend) {
+
+        /* find sequence of grids with identical geometry */
+
+        pgrid_ref = pgrid[nstart];
+        for (nend = nstart + 1; nend < ngrid && nend - nstart < GRID_INTERP_BATCH_SIZE; nend++)
+            if (!isSameGrid3dGeometry(pgrid_ref, pgrid[nend]))
+                break;
+
+        /* calculate grid locations on edge of solid containing point */
+
+        xoff = (xloc - pgrid_ref->origx) / pgrid_ref->dx;
+        yoff = (yloc - pgrid_ref->origy) / pgrid_ref->dy;
+        zoff = (zloc - pgrid_ref->origz) / pgrid_ref->dz;
+
+        ix0 = (int) (xoff - VERY_SMALL_DOUBLE);
+        iy0 = (int) (yoff - VERY_SMALL_DOUBLE);
+        iz0 = (int) (zoff - VERY_SMALL_DOUBLE);
+
+        ix1 = (ix0 < pgrid_ref->numx - 1) ? ix0 + 1 : ix0;
+        iy1 = (iy0 < pgrid_ref->numy - 1) ? iy0 + 1 : iy0;
+        iz1 = (iz0 < pgrid_ref->numz - 1) ? iz0 + 1 : iz0;
+
+        xdiff = xoff - (DOUBLE) ix0;
+        ydiff = yoff - (DOUBLE) iy0;
+        zdiff = zoff - (DOUBLE) iz0;
+
+        if (xdiff < 0.0 || xdiff > 1.0 || ydiff < 0.0 || ydiff > 1.0 || zdiff < 0.0 || zdiff > 1.0) {
+            for (n = nstart; n < nend; n++)
+                values[n] = -VERY_LARGE_FLOAT;
+            continue;
+        }
+
+        numz = pgrid_ref->numz;
+        numyz = pgrid_ref->numy * numz;
+        offset[0] = ix0 * numyz + iy0 * numz + iz0;
+        offset[1] = ix0 * numyz + iy0 * numz + iz1;
+        offset[2] = ix0 * numyz + iy1 * numz + iz0;
+        offset[3] = ix0 * numyz + iy1 * numz + iz1;
+        offset[4] = ix1 * numyz + iy0 * numz + iz0;
+        offset[5] = ix1 * numyz + iy0 * numz + iz1;
+        offset[6] = ix1 * numyz + iy1 * numz + iz0;
+        offset[7] = ix1 * numyz + iy1 * numz + iz1;
+
+        /* location at grid node */
+
+        if (xdiff + ydiff + zdiff < SMALL_FLOAT) {
+            for (n = nstart; n < nend; n++)
+                values[n] = *((GRID_FLOAT_TYPE *) pgrid[n]->buffer + offset[0]);
+            continue;
+        }
+
+        /* read vertex values from grid arrays */
+
+        for (n = nstart; n < nend; n++) {
+            buffer = (GRID_FLOAT_TYPE *) pgrid[n]->buffer;
+            for (k = 0; k < 8; k++)
+                vval[k][n - nstart] = *(buffer + offset[k]);
+        }
+
+        /* interpolate values, as InterpCubeLagrange(), checking for invalid / mask nodes as ReadAbsInterpGrid3d() */
+
+        oneMinusXdiff = 1.0 - xdiff;
+        oneMinusYdiff = 1.0 - ydiff;
+        oneMinusZdiff = 1.0 - zdiff;
+        int check_mask = pgrid_ref->type != GRID_SSST_TIMECORR;
+
+        for (n = 0; n < nend - nstart; n++) {
+            DOUBLE value = oneMinusXdiff * (
+                    oneMinusYdiff * (vval[0][n] * oneMinusZdiff + vval[1][n] * zdiff)
+                    + ydiff * (vval[2][n] * oneMinusZdiff + vval[3][n] * zdiff)
+                    )
+                    + xdiff * (
+                    oneMinusYdiff * (vval[4][n] * oneMinusZdiff + vval[5][n] * zdiff)
+                    + ydiff * (vval[6][n] * oneMinusZdiff + vval[7][n] * zdiff)
+                    );
+            if (check_mask && (vval[0][n] < 0.0 || vval[1][n] < 0.0 || vval[2][n] < 0.0 || vval[3][n] < 0.0
+                    || vval[4][n] < 0.0 || vval[5][n] < 0.0 || vval[6][n] < 0.0 || vval[7][n] < 0.0))
+                value = -VERY_LARGE_FLOAT;
+            values[nstart + n] = (GRID_FLOAT_TYPE) value;
+        }
+    }
+
+}
+
+
 /** function to read grid data from disk or buffer at absolute location with interpolation ***/
 
 /* 2D version - ix assumed = 0 */
@@ -4583,6 +4935,145 @@ int rect2latlon(int n_proj, double xrect, double yrect, double* pdlat, double* p
     return (-1);
 }
 
+/** function to convert arrays of lat/long coord to rectangular km coord, same as latlon2rect() for each element
+ *
+ *  projection type and parameters are evaluated once for all elements */
+
+int latlon2rect_array(int n_proj, double* dlat, double* dlong, double* xrect, double* yrect, int num) {
+
+    int n;
+    double xtemp, ytemp;
+    double xlt1;
+    double cosang = map_cosang[n_proj], sinang = map_sinang[n_proj];
+    double orig_lat = map_orig_lat[n_proj], orig_long = map_orig_long[n_proj];
+
+
+    if (map_itype[n_proj] == MAP_TRANS_GLOBAL || map_itype[n_proj] == MAP_TRANS_NONE) {
+        for (n = 0; n < num; n++) {
+            xrect[n] = dlong[n];
+            yrect[n] = dlat[n];
+        }
+        return (0);
+
+    } else if (map_itype[n_proj] == MAP_TRANS_SIMPLE) {
+        for (n = 0; n < num; n++) {
+            xtemp = dlong[n] - orig_long;
+            xtemp = xtemp > 180.0 ? xtemp - 360.0 : xtemp;
+            xtemp = xtemp < -180.0 ? xtemp + 360.0 : xtemp;
+            xtemp = xtemp * c111 * cos(cRPD * dlat[n]);
+            ytemp = (dlat[n] - orig_lat) * c111;
+            xrect[n] = xtemp * cosang - ytemp * sinang;
+            yrect[n] = ytemp * cosang + xtemp * sinang;
+        }
+        return (0);
+
+    } else if (map_itype[n_proj] == MAP_TRANS_SDC) {
+        for (n = 0; n < num; n++) {
+            xtemp = dlong[n] - orig_long;
+            xtemp = xtemp > 180.0 ? xtemp - 360.0 : xtemp;
+            xtemp = xtemp < -180.0 ? xtemp + 360.0 : xtemp;
+            ytemp = dlat[n] - orig_lat;
+            xlt1 = atan(MAP_TRANS_SDC_DRLT * tan(DE2RA * (dlat[n] + orig_lat) / 2.0));
+            xtemp = xtemp * map_sdc_xlnkm[n_proj] * cos(xlt1);
+            ytemp = ytemp * map_sdc_xltkm[n_proj];
+            xrect[n] = xtemp * cosang - ytemp * sinang;
+            yrect[n] = ytemp * cosang + xtemp * sinang;
+        }
+        return (0);
+
+    } else if (map_itype[n_proj] == MAP_TRANS_LAMBERT
+            || map_itype[n_proj] == MAP_TRANS_TM
+            || map_itype[n_proj] == MAP_TRANS_AZ_EQUID) {
+        for (n = 0; n < num; n++) {
+            if (map_itype[n_proj] == MAP_TRANS_LAMBERT)
+                lamb(n_proj, dlong[n], dlat[n], &xtemp, &ytemp);
+            else if (map_itype[n_proj] == MAP_TRANS_TM)
+                tm(n_proj, dlong[n], dlat[n], &xtemp, &ytemp);
+            else
+                azeqdist(n_proj, dlong[n], dlat[n], &xtemp, &ytemp);
+            xtemp /= 1000.0; /* m -> km */
+            ytemp /= 1000.0; /* m -> km */
+            xrect[n] = xtemp * cosang - ytemp * sinang;
+            yrect[n] = ytemp * cosang + xtemp * sinang;
+        }
+        return (0);
+
+    }
+
+    return (-1);
+
+}
+
+/** function to convert arrays of rectangular km coord to lat/long, same as rect2latlon() for each element
+ *
+ *  projection type and parameters are evaluated once for all elements */
+
+int rect2latlon_array(int n_proj, double* xrect, double* yrect, double* dlat, double* dlong, int num) {
+
+    int n;
+    double xtemp, ytemp;
+    double xlt1;
+    double cosang = map_cosang[n_proj], sinang = map_sinang[n_proj];
+    double orig_lat = map_orig_lat[n_proj], orig_long = map_orig_long[n_proj];
+
+    if (map_itype[n_proj] == MAP_TRANS_NONE) {
+        for (n = 0; n < num; n++) {
+            dlat[n] = yrect[n];
+            dlong[n] = xrect[n];
+        }
+        return (0);
+
+    } else if (map_itype[n_proj] == MAP_TRANS_GLOBAL) {
+        for (n = 0; n < num; n++) {
+            dlat[n] = yrect[n];
+            dlong[n] = xrect[n];
+        }
+
+    } else if (map_itype[n_proj] == MAP_TRANS_SIMPLE) {
+        for (n = 0; n < num; n++) {
+            xtemp = xrect[n] * cosang + yrect[n] * sinang;
+            ytemp = yrect[n] * cosang - xrect[n] * sinang;
+            dlat[n] = orig_lat + ytemp / c111;
+            dlong[n] = orig_long + xtemp / (c111 * cos(cRPD * dlat[n]));
+        }
+
+    } else if (map_itype[n_proj] == MAP_TRANS_SDC) {
+        for (n = 0; n < num; n++) {
+            xtemp = xrect[n] * cosang + yrect[n] * sinang;
+            ytemp = yrect[n] * cosang - xrect[n] * sinang;
+            ytemp = ytemp / map_sdc_xltkm[n_proj];
+            dlat[n] = orig_lat + ytemp;
+            xlt1 = atan(MAP_TRANS_SDC_DRLT * tan(DE2RA * (dlat[n] + orig_lat) / 2.0));
+            xtemp = xtemp / (map_sdc_xlnkm[n_proj] * cos(xlt1));
+            dlong[n] = orig_long + xtemp;
+        }
+
+    } else if (map_itype[n_proj] == MAP_TRANS_LAMBERT
+            || map_itype[n_proj] == MAP_TRANS_TM
+            || map_itype[n_proj] == MAP_TRANS_AZ_EQUID) {
+        for (n = 0; n < num; n++) {
+            xtemp = xrect[n] * cosang + yrect[n] * sinang;
+            ytemp = yrect[n] * cosang - xrect[n] * sinang;
+            if (map_itype[n_proj] == MAP_TRANS_LAMBERT)
+                ilamb(n_proj, dlong + n, dlat + n, xtemp * 1000.0, ytemp * 1000.0);
+            else if (map_itype[n_proj] == MAP_TRANS_TM)
+                itm(n_proj, dlong + n, dlat + n, xtemp * 1000.0, ytemp * 1000.0);
+            else
+                iazeqdist(n_proj, dlong + n, dlat + n, xtemp * 1000.0, ytemp * 1000.0);
+        }
+
+    } else {
+        return (-1);
+    }
+
+    // prevent longitude outside of -180 -> 180 deg range
+    for (n = 0; n < num; n++) {
+        dlong[n] = dlong[n] < -180.0 ? dlong[n] + 360.0 : (dlong[n] > 180.0 ? dlong[n] - 360.0 : dlong[n]);
+    }
+
+    return (0);
+}
+
 /** function to convert rectangular km angle to lat/long angle */
 
 double rect2latlonAngle(int n_proj, double rectAngle) {
@@ -4627,18 +5118,85 @@ double latlon2rectAngle(int n_proj, double latlonAngle) {
 
 int ConvertSourceLoc(int n_proj, SourceDesc *source, int numSources, int toXY, int toLatLon) {
 
-    int istat = 0, nsource;
+    int istat = 0, nsource, nconv;
     SourceDesc *srce_in;
+    double *coord_in1, *coord_in2, *coord_out1, *coord_out2;
 
 
-    for (nsource = 0; nsource < numSources; nsource++) {
+    // convert all sources together, if no memory for coordinate arrays convert one source at a time
+    if (numSources < 2 || (coord_in1 = (double *) malloc(4 * numSources * sizeof (double))) == NULL) {
+        for (nsource = 0; nsource < numSources; nsource++) {
 
-        srce_in = source + nsource;
+            srce_in = source + nsource;
 
-        istat = ConvertASourceLocation(n_proj, srce_in, toXY, toLatLon);
+            istat = ConvertASourceLocation(n_proj, srce_in, toXY, toLatLon);
 
+        }
+        return (istat);
+    }
+    coord_in2 = coord_in1 + numSources;
+    coord_out1 = coord_in2 + numSources;
+    coord_out2 = coord_out1 + numSources;
+
+    if (toXY) {
+        nconv = 0;
+        for (nsource = 0; nsource < numSources; nsource++) {
+            srce_in = source + nsource;
+            if (srce_in->is_coord_latlon && !srce_in->is_coord_xyz) {
+                coord_in1[nconv] = srce_in->dlat;
+                coord_in2[nconv++] = srce_in->dlong;
+            }
+        }
+        if (nconv > 0 && latlon2rect_array(n_proj, coord_in1, coord_in2, coord_out1, coord_out2, nconv) < 0) {
+            // array conversion failed, output arrays are undefined, convert one source at a time
+            for (nsource = 0; nsource < numSources; nsource++) {
+                if (ConvertASourceLocation(n_proj, source + nsource, 1, 0) < 0)
+                    istat = -1;
+            }
+        } else {
+            nconv = 0;
+            for (nsource = 0; nsource < numSources; nsource++) {
+                srce_in = source + nsource;
+                if (srce_in->is_coord_latlon && !srce_in->is_coord_xyz) {
+                    srce_in->x = coord_out1[nconv];
+                    srce_in->y = coord_out2[nconv++];
+                    srce_in->is_coord_xyz = 1;
+                    srce_in->z = srce_in->depth;
+                }
+            }
+        }
+    }
+    if (toLatLon) {
+        nconv = 0;
+        for (nsource = 0; nsource < numSources; nsource++) {
+            srce_in = source + nsource;
+            if (srce_in->is_coord_xyz && !srce_in->is_coord_latlon) {
+                coord_in1[nconv] = srce_in->x;
+                coord_in2[nconv++] = srce_in->y;
+            }
+        }
+        if (nconv > 0 && rect2latlon_array(n_proj, coord_in1, coord_in2, coord_out1, coord_out2, nconv) < 0) {
+            // array conversion failed, output arrays are undefined, convert one source at a time
+            for (nsource = 0; nsource < numSources; nsource++) {
+                if (ConvertASourceLocation(n_proj, source + nsource, 0, 1) < 0)
+                    istat = -1;
+            }
+        } else {
+            nconv = 0;
+            for (nsource = 0; nsource < numSources; nsource++) {
+                srce_in = source + nsource;
+                if (srce_in->is_coord_xyz && !srce_in->is_coord_latlon) {
+                    srce_in->dlat = coord_out1[nconv];
+                    srce_in->dlong = coord_out2[nconv++];
+                    srce_in->is_coord_latlon = 1;
+                    srce_in->depth = srce_in->z;
+                }
+            }
+        }
     }
 
+    free(coord_in1);
+
     return (istat);
 
 }
@@ -108,6 +108,8 @@ www.alomax.net
 
 #define DOUBLE double
 
+#define GRID_INTERP_BATCH_SIZE 64   // max number of grids interpolated together by ReadAbsInterpGrid3dBatch()
+
 #define OUT_LEVEL_0 stderr
 #define OUT_LEVEL_1 stdout
 #define OUT_LEVEL_2 fp_null
@@ -264,6 +266,28 @@ typedef struct {
 }
 GridDesc_Cascading;
 
+/** quantised grid description
+ *
+ * quantised grid buffer files (<fileroot>.qbuf) are read instead of <fileroot>.buf if the latter does not exist,
+ * they store the grid in blocks of GRID_QUANT_BLOCK^3 nodes (blocks ordered x-y-z, nodes x-y-z within a block,
+ * padded at the upper grid edges) as 16 bit codes relative to a reference value per block:
+ *   char[8]   GRID_QUANT_MAGIC
+ *   int32     numx, numy, numz, GRID_QUANT_BLOCK (native byte order of the writer, detected on read)
+ *   float     offset[nblock], float scale[nblock]
+ *   uint16    code[nblock * GRID_QUANT_BLOCK^3]
+ * node value = offset + code * scale, code GRID_QUANT_INVALID flags a negative (invalid) node, read as -VERY_LARGE_FLOAT.
+ * scale = (max - min) / (GRID_QUANT_INVALID - 1) over the valid nodes of a block, the maximum absolute error of a node value
+ * is scale / 2 (e.g. < 0.05 ms for a block spanning 5 s), the error of a value interpolated with InterpCubeLagrange()
+ * is bounded by the largest error of the 8 cell vertices, since the interpolation weights are positive and sum to one.
+ * the buffer of a quantised grid in memory holds offset, scale and code arrays, array access pointers are not available.
+ */
+#define IS_NOT_QUANTISED 0
+#define IS_QUANTISED -517253627   // want value that is extremely unlikely to be in uninitialized int
+#define GRID_QUANT_MAGIC "NLLQBUF1"
+#define GRID_QUANT_BLOCK 8
+#define GRID_QUANT_INVALID 65535
+#define GRID_QUANT_HDR_SIZE (8 + 4 * sizeof (int))
+
 /* grid  description */
 
 typedef struct {
@@ -285,6 +309,7 @@ typedef struct {
     GridDesc_Cascading gridDesc_Cascading; // GridDesc_Cascading description, initialized if this grid is a cascading grid (flagGridCascading==IS_CASCADING)
     // 20161021 AJL - added
     char mapProjStr[2 * MAXLINE]; // holds map projection description string from grid hdr if present
+    int flagGridQuantised; // set to IS_QUANTISED to flag that this grid is read from a quantised grid buffer file
 }
 GridDesc;
 
@@ -403,6 +428,8 @@ typedef struct {
 						from travel time using LOCGAU2 params) */
     double delay; /* time delay (is subtracted from arrival seconds when phase read */
     double elev_corr; /* elevation correction (is added to arrival seconds when phase read */
+    char crust_corr_phase; /* 'P' or 'S' for crustal correction, '\0' for none, set in initCrustElevCorrection() */
+    double crust_corr_station; /* station crustal and elevation correction, set in initCrustElevCorrection() */
     int day_of_year; /* day of year (of earliest arrival) */
     long double obs_time; /* corrected observed time; secs from beginning of day of year */
 
@@ -416,6 +443,7 @@ typedef struct {
     double obs_centered; /* centered observed time */
 
     double pred_travel_time; /* predicted travel time */
+    double pred_epi_dist; /* epicentral distance for 2D grid predicted travel time (km, deg for GLOBAL) */
     double pred_centered; /* centered predicted travel time */
     double pred_travel_time_best; /* predicted travel time from best solution */
 
@@ -593,6 +621,9 @@ typedef struct {
     int ipos;
     int nScatterSaved;
     int numClipped;
+    // Metropolis multi-chain
+    int nChains; /* number of Metropolis chains */
+    Vect3D rhat; /* Gelman-Rubin potential scale reduction of x, y, z over chains */
     int flag_ignore; /* ignore hypocenter for location */
     double dotime; /* sec correction to otime */
     //
@@ -775,6 +806,8 @@ void get_velfile(char*);
 int convertCoordsRect(int, int, double, double, double *, double *);
 int latlon2rect(int, double, double, double*, double*);
 int rect2latlon(int, double, double, double*, double*);
+int latlon2rect_array(int, double*, double*, double*, double*, int);
+int rect2latlon_array(int, double*, double*, double*, double*, int);
 double rect2latlonAngle(int, double);
 double latlon2rectAngle(int, double);
 double getGMTJVAL(int, char*, double, double, double, double, double, double);
@@ -795,6 +828,7 @@ int MulConstGrid(GridDesc* pgrid_sum, GridDesc* pgrid_new, FILE* fp_grid_new, do
 int testIdentical(GridDesc* pGrid1, GridDesc* pGrid2);
 int WriteGrid3dBuf(GridDesc*, SourceDesc*, char*, char*);
 int WriteGrid3dHdr(GridDesc*, SourceDesc*, char*, char*);
+int WriteGrid3dHdrStream(FILE*, GridDesc*, SourceDesc*);
 int ReadGrid3dBuf(GridDesc*, FILE*);
 int ReadGrid3dHdr(GridDesc*, SourceDesc*, char*, char*);
 int ReadGrid3dHdr_grid_description(FILE *fpio, GridDesc* pgrid, char *fname);
@@ -815,6 +849,7 @@ float InterpCubeAngles(DOUBLE, DOUBLE, DOUBLE, DOUBLE, DOUBLE,
         DOUBLE, DOUBLE, DOUBLE, DOUBLE, DOUBLE, DOUBLE);
 GRID_FLOAT_TYPE ReadAbsInterpGrid3d(FILE *, GridDesc*, double, double,
         double, int clean_casc_allocs);
+void ReadAbsInterpGrid3dBatch(GridDesc**, int, double, double, double, GRID_FLOAT_TYPE *);
 DOUBLE InterpSquareLagrange(DOUBLE, DOUBLE,
         DOUBLE, DOUBLE, DOUBLE, DOUBLE);
 DOUBLE ReadAbsInterpGrid2d(FILE *, GridDesc*,
@@ -831,6 +866,8 @@ int IsGrid2DBigEnough(GridDesc*, GridDesc*, SourceDesc*,
 // 20161019 AJL - added
 int isCascadingGrid(GridDesc* pgrid);
 void setCascadingGrid(GridDesc* pgrid);
+int isQuantisedGrid(GridDesc* pgrid);
+size_t QuantisedGridBufferSize(GridDesc* pgrid);
 void* AllocateGrid_Cascading(GridDesc* pgrid, int allocate_buffer);
 void FreeGrid_Cascading(GridDesc * pgrid);
 
@@ -873,6 +910,7 @@ GridDesc* cloneGridDesc(GridDesc* pgrid_orig);
 
 /* source/station functions */
 double GetEpiDist(SourceDesc*, double, double);
+void GetEpiDistArray(double, double, double*, double*, double*, int);
 double GetEpiAzim(SourceDesc*, double, double);
 double GetEpiDistSta(StationDesc*, double, double);
 double GetEpiAzimSta(StationDesc*, double, double);
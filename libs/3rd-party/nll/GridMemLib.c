@@ -39,6 +39,9 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 //#include "ran1.h"
 #include "GridMemLib.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 
 
 /*------------------------------------------------------------/ */
@@ -165,6 +168,8 @@ void NLL_FreeGridMemory() {
     }
     free(GridMemList); // 20141219 AJL - bug fix, added this free
     GridMemList = NULL;
+    GridMemListSize = 0;
+    GridMemListNumElements = 0;
 
 }
 
@@ -214,6 +219,46 @@ void NLL_DestroyGridArray(GridDesc* pgrid) {
     DestroyGridArray(pgrid);
 }
 
+/*** map grid file of list element into memory, returns 0 on success,
+ * -1 if the grid cannot be mapped and must be read and -2 on error ***/
+
+static int GridMemList_MapGridFile(GridMemStruct* pGridMemStruct, FILE* fpio) {
+
+    GridDesc* pgrid = pGridMemStruct->pgrid;
+    struct stat st;
+    void* mapped;
+
+
+    /* byte swapped and cascading grids must be converted after reading,
+     * quantised grid buffer files start with a header */
+    if (pgrid->iSwapBytes || isCascadingGrid(pgrid) || isQuantisedGrid(pgrid))
+        return (-1);
+
+    if (fstat(fileno(fpio), &st) != 0 || (size_t) st.st_size < pgrid->buffer_size)
+        return (-1);
+
+    /* private writable mapping: pages are shared between processes
+     * through the page cache as long as they are not modified */
+    mapped = mmap(NULL, pgrid->buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fpio), 0);
+    if (mapped == MAP_FAILED)
+        return (-1);
+
+    /* replace allocated buffer by mapping */
+    DestroyGridArray(pgrid);
+    FreeGrid(pgrid);
+    pgrid->buffer = mapped;
+    pGridMemStruct->buffer = mapped;
+    pGridMemStruct->mapped = 1;
+    pGridMemStruct->array = CreateGridArray(pgrid);
+    if (pGridMemStruct->array == NULL)
+        return (-2);
+
+    if (message_flag >= GRIDMEM_MESSAGE)
+        printf("GridMemManager: Mapped grid file: %s\n", pgrid->title);
+
+    return (0);
+}
+
 /*** wrapper function to read entire grid buffer from disk ***/
 
 int NLL_ReadGrid3dBuf(GridDesc* pgrid, FILE* fpio) {
@@ -227,7 +272,17 @@ int NLL_ReadGrid3dBuf(GridDesc* pgrid, FILE* fpio) {
     if (USE_GRID_LIST && (index = GridMemList_IndexOfGridDesc(0, pgrid)) >= 0) {
         pGridMemStruct = GridMemList_ElementAt(index);
         if (!pGridMemStruct->grid_read) {
-            istat = ReadGrid3dBuf(pGridMemStruct->pgrid, fpio);
+            istat = -1;
+            if (GridMemMapFiles)
+                istat = GridMemList_MapGridFile(pGridMemStruct, fpio);
+            if (istat == -2)
+                return (-1);
+            if (istat == 0) {
+                /* caller holds the replaced buffer and array */
+                pgrid->buffer = pGridMemStruct->buffer;
+                pgrid->array = pGridMemStruct->array;
+            } else
+                istat = ReadGrid3dBuf(pGridMemStruct->pgrid, fpio);
             pGridMemStruct->grid_read = 1;
         }
     } else {
@@ -252,6 +307,7 @@ GridMemStruct* GridMemList_AddGridDesc(GridDesc* pgrid) {
     pnewGridMemStruct->array = CreateGridArray(pnewGridMemStruct->pgrid);
     pnewGridMemStruct->active = 1;
     pnewGridMemStruct->grid_read = 0;
+    pnewGridMemStruct->mapped = 0;
 
     GridMemList_AddElement(pnewGridMemStruct);
 
@@ -318,7 +374,11 @@ void GridMemList_RemoveElementAt(int index) {
     if (message_flag >= GRIDMEM_MESSAGE)
         printf("GridMemManager: Remove grid (%d/%d): %s\n", index, GridMemListNumElements, pGridMemStruct->pgrid->title);
     DestroyGridArray(pGridMemStruct->pgrid);
-    FreeGrid(pGridMemStruct->pgrid);
+    if (pGridMemStruct->mapped) {
+        munmap(pGridMemStruct->buffer, pGridMemStruct->pgrid->buffer_size);
+        pGridMemStruct->pgrid->buffer = NULL;
+    } else
+        FreeGrid(pGridMemStruct->pgrid);
     free(pGridMemStruct->pgrid);
     pGridMemStruct->pgrid = NULL;
     free(pGridMemStruct);
@@ -346,6 +406,10 @@ GridMemStruct* GridMemList_TryToReplaceElementAt(GridMemStruct* pGridMemStruct,
 
     //printf("DEBUG: GridMemList_TryToReplaceElementAt: test %s / %s\n", pGridMemStruct->pgrid->title, pgrid->title);
 
+    // mapped grid files cannot be overwritten
+    if (pGridMemStruct->mapped)
+        return (NULL);
+
     // check all relevant grid parameters are identical
     if (pgrid->dx != pGridMemStruct->pgrid->dx
             || pgrid->dy != pGridMemStruct->pgrid->dy
@@ -373,6 +437,9 @@ GridMemStruct* GridMemList_TryToReplaceElementAt(GridMemStruct* pGridMemStruct,
         //printf("return 5\n");
         return (NULL);
     }
+    if (pgrid->flagGridQuantised != pGridMemStruct->pgrid->flagGridQuantised) {
+        return (NULL);
+    }
     if (pgrid->flagGridCascading) {
         if (pgrid->gridDesc_Cascading.num_z_merge_depths != pGridMemStruct->pgrid->gridDesc_Cascading.num_z_merge_depths) {
             //printf("return 6\n");
@@ -388,6 +455,8 @@ GridMemStruct* GridMemList_TryToReplaceElementAt(GridMemStruct* pGridMemStruct,
     /* following should not be needed, since only dependent (?) on above parameters
      * also, makes allocations and probably inefficient*/
     size_t buffer_size = (size_t) (pgrid->numx * pgrid->numy * pgrid->numz * sizeof (GRID_FLOAT_TYPE));
+    if (isQuantisedGrid(pgrid))
+        buffer_size = QuantisedGridBufferSize(pgrid);
     if (pgrid->flagGridCascading) {
         AllocateGrid_Cascading(pgrid, 0); // sets buffer size but does not allocate buffer
         buffer_size = pgrid->buffer_size;
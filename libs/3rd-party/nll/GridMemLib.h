@@ -8,6 +8,7 @@ typedef struct gridMem {	/* 3D grid data in memory */
 	void*** array;		/* corresponding array access to buffer */
 	int grid_read;		/* grid read flag  = 1 if grid has been read from disk */
 	int active;		/* active flag  = 1 if grid is being used in current location */
+	int mapped;		/* mapped flag  = 1 if buffer is a read-only mapping of the grid file */
 
 
 } GridMemStruct;
@@ -18,6 +19,11 @@ EXTERN_TXT int GridMemListSize;
 EXTERN_TXT int GridMemListNumElements;
 EXTERN_TXT int Num3DGridReadToMemory, MaxNum3DGridMemory;
 EXTERN_TXT int GridMemListTotalNumElementsAdded;
+/* if = 1, grids in memory list are kept between calls to NLLoc() and must be released by caller with NLL_FreeGridMemory() */
+EXTERN_TXT int GridMemListPersistent;
+/* if = 1, grid files are mapped into memory instead of being read into private buffers,
+ * processes using the same grids then share their pages */
+EXTERN_TXT int GridMemMapFiles;
 
 /* GridLib wrapper functions */
 void* NLL_AllocateGrid(GridDesc* pgrid);
@@ -161,10 +161,13 @@ int NLLoc
 
     // GridMemLib
     MaxNum3DGridMemory = -1;
-    GridMemList = NULL;
-    GridMemListSize = 0;
-    GridMemListNumElements = 0;
-    GridMemListTotalNumElementsAdded = 0;
+    // grids persisting from previous call are re-used (see GridMemListPersistent)
+    if (!GridMemListPersistent || GridMemList == NULL) {
+        GridMemList = NULL;
+        GridMemListSize = 0;
+        GridMemListNumElements = 0;
+        GridMemListTotalNumElementsAdded = 0;
+    }
 
     // otime limits
     OtimeLimitList = NULL;
@@ -676,7 +679,8 @@ cleanup:
 cleanup_return:
 
     //  20141219 AJL - bug? fix, moved here from inside events/obs loop!
-    NLL_FreeGridMemory();
+    if (!GridMemListPersistent)
+        NLL_FreeGridMemory();
 
     if (!iSaveNone)
         CloseSummaryFiles();
@@ -115,6 +115,8 @@ e-mail: anthony@alomax.net  web: http://www.alomax.net
 #include "otime_limit.h"
 #include "NLLocLib.h"
 
+#include <pthread.h>
+
 #ifdef CUSTOM_ETH
 #include "custom_eth/eth_functions.h"
 #endif
@@ -130,11 +132,29 @@ int clean_memory(int istat);
 double *ot_ml_arrival = NULL; // array of ot estimate for each arrival
 double *ot_ml_arrival_edt_sum = NULL; // array of weight of ot estimate for each arrival
 int isize_ot_ml_array = 0;
+// guards EDT_otime_weight_active if cells are evaluated concurrently (see LocOctree)
+static pthread_mutex_t edt_otime_weight_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // ConstWeightMatrix() allocations
 MatrixDouble wt_matrix = NULL;
 MatrixDouble edt_matrix = NULL;
 int last_matrix_alloc_size = -1;
+EdtPairIndex edt_pair_index;
+EdtArrivalData edt_arrival_data;
+static int AllocEdtArrivalData(EdtArrivalData *pdata, int num_arrivals);
+static void FreeEdtArrivalData(EdtArrivalData *pdata);
+
+// single pass statistics of scatter samples, accumulated while the samples are generated
+static SampleStatistics scatter_statistics;
+
+// hash index of arrivals for duplicate and companion arrival checks, rebuilt for each location
+static ArrivalIndex arrival_index;
+static void ResetArrivalIndex(ArrivalIndex *pindex);
+static void FreeArrivalIndex(ArrivalIndex *pindex);
+static int UpdateArrivalIndex(ArrivalIndex *pindex, ArrivalDesc *arrival, int num_arrivals);
+static int IsDuplicateArrivalIndexed(ArrivalIndex *pindex, int ntest, int rejectOnlyForExactTimeMatch);
+static int IsSameArrivalIndexed(ArrivalIndex *pindex, int ntest, char *phase_test);
+static int FindDuplicateTimeGridIndexed(ArrivalIndex *pindex, int ntest);
 
 /** function to perform grid search location */
 
@@ -156,6 +176,7 @@ int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject
 
 
     Hypocenter.nScatterSaved = -1;
+    Hypocenter.nChains = 0;
 
 
 
@@ -248,11 +269,13 @@ int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject
                 Arrival, NumArrivalsLocation, &Metrop,
                 MetLearn + MetEquil, MetStepInit);
 
-        /* allocate scatter array for saved samples */
-        iSizeOfFdata = (1 + MetUse / MetSkip) * 4 * sizeof (float);
-        if ((fdata = (float *) malloc(iSizeOfFdata)) == NULL) {
-            nll_puterr("ERROR: creating array for scatter samples.");
-            return (clean_memory(EXIT_ERROR_LOCATE));
+        /* allocate scatter array for saved samples, only needed if samples are written or returned */
+        if (iSaveNLLocEvent || return_scatter_sample) {
+            iSizeOfFdata = MetNumSavedMax() * 4 * sizeof (float);
+            if ((fdata = (float *) malloc(iSizeOfFdata)) == NULL) {
+                nll_puterr("ERROR: creating array for scatter samples.");
+                return (clean_memory(EXIT_ERROR_LOCATE));
+            }
         }
         //NumAllocations++;
 
@@ -295,6 +318,8 @@ int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject
 
     /* since sorted, reset companion indices */
     if (VpVsRatio > 0.0) {
+        ResetArrivalIndex(&arrival_index);
+        UpdateArrivalIndex(&arrival_index, Arrival, NumArrivals);
         //for (narr = 0; narr < NumArrivalsLocation; narr++) {
         for (narr = 0; narr < NumArrivals; narr++) {
             if (Arrival[narr].n_companion < 0)
@@ -304,7 +329,7 @@ int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject
             //             if (IsPhaseID(Arrival[narr].phase, "S") &&
             //        (Arrival[narr].n_companion = IsSameArrival(Arrival, narr, narr, "P")) < 0) {
             if (IsPhaseID(Arrival[narr].phase, "S") &&
-                    (Arrival[narr].n_companion = IsSameArrival(Arrival, NumArrivals, narr, "P")) < 0) {
+                    (Arrival[narr].n_companion = IsSameArrivalIndexed(&arrival_index, narr, "P")) < 0) {
                 //
                 sprintf(MsgStr, "ERROR: cannot find companion arrival: %s %s n_companion %d->%d", Arrival[narr].label, Arrival[narr].phase, n_companion_save, Arrival[narr].n_companion);
                 nll_puterr(MsgStr);
@@ -325,6 +350,11 @@ int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject
 
     /* do search */
 
+    InitSampleStatistics(&scatter_statistics, GeometryMode == MODE_GLOBAL);
+
+    if (ApplyCrustElevCorrFlag && GeometryMode == MODE_GLOBAL)
+        initCrustElevCorrection(Arrival, NumArrivals);
+
     if (SearchType == SEARCH_GRID) {
 
         /* grid-search location (fill location grid) */
@@ -491,10 +521,10 @@ int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject
             }
         }
 
-        /* calculate "traditional" statistics */
-        Hypocenter.expect = CalcExpectationSamples(fdata, Hypocenter.nScatterSaved);
+        /* calculate "traditional" statistics, accumulated in a single pass while the samples were generated */
+        Hypocenter.expect = GetSampleStatisticsExpectation(&scatter_statistics);
         istat = rect2latlon(0, Hypocenter.expect.x, Hypocenter.expect.y, &(Hypocenter.expect_dlat), &(Hypocenter.expect_dlong));
-        Hypocenter.cov = CalcCovarianceSamples(fdata, Hypocenter.nScatterSaved, &Hypocenter.expect);
+        Hypocenter.cov = GetSampleStatisticsCovariance(&scatter_statistics);
         if (Hypocenter.nScatterSaved) {
             Hypocenter.ellipsoid = CalcErrorEllipsoid(&Hypocenter.cov, DELTA_CHI_SQR_68_3);
             Hypocenter.ellipse = CalcHorizontalErrorEllipse(&Hypocenter.cov, DELTA_CHI_SQR_68_2);
@@ -743,8 +773,8 @@ int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject
 
     } else if (SearchType == SEARCH_OCTTREE) {
 
-        // free results tree - IMPORTANT!
-        freeResultTree(resultTreeRoot);
+        // free results tree - IMPORTANT! (nodes are freed with their pool in clean_memory())
+        resultTreeRoot = NULL;
 
         /* free oct-tree memory */
         if (!return_oct_tree_grid) {
@@ -851,6 +881,13 @@ int clean_memory(int istat) {
     ot_ml_arrival_edt_sum = NULL;
     isize_ot_ml_array = 0;
 
+    FreeArrivalIndex(&arrival_index);
+
+    // free Octtree results tree nodes, the pool would otherwise keep the peak size of all locations
+    freeNodePool(resultTreeNodePool);
+    resultTreeNodePool = NULL;
+    resultTreeRoot = NULL;
+
     return (istat);
 
 }
@@ -1296,7 +1333,9 @@ int checkObs(ArrivalDesc *arrival, int nobs) {
         //		) {
         // AJL 20200131 - iRejectDuplicateArrivals > 1 flags no check, accept all arrivals
         //if (IsDuplicateArrival(arrival, nobs + 1, nobs, !iRejectDuplicateArrivals) >= 0) {
-        if (iRejectDuplicateArrivals > -2 && IsDuplicateArrival(arrival, nobs + 1, nobs, !iRejectDuplicateArrivals) >= 0) {
+        //if (iRejectDuplicateArrivals > -2 && IsDuplicateArrival(arrival, nobs + 1, nobs, !iRejectDuplicateArrivals) >= 0) {
+        UpdateArrivalIndex(&arrival_index, arrival, nobs);
+        if (iRejectDuplicateArrivals > -2 && IsDuplicateArrivalIndexed(&arrival_index, nobs, !iRejectDuplicateArrivals) >= 0) {
 
             sprintf(MsgStr,
                     "WARNING: duplicate arrival, rejecting observation: %s %s", arrival[nobs].label, arrival[nobs].phase);
@@ -1348,6 +1387,8 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
 
     nll_putmsg(4, "Dummy message");
 
+    ResetArrivalIndex(&arrival_index);
+
     // 20180907 AJL - added phypo to recover location information (e.g. magntiude) from observation file
     // 20180907 AJL while ((istat = GetNextObs(fp_obs, arrival + nobs, ftype_obs, ntry++ == 0)) != EOF) {
     while ((istat = GetNextObs(phypo, fp_obs, arrival + nobs, ftype_obs, ntry++ == 0)) != EOF) {
@@ -1452,9 +1493,14 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
 
     /* check each arrival and initialize */
 
+    // arrivals were sorted, index arrivals 0 to nobs - 1 again as each arrival is checked
+    ResetArrivalIndex(&arrival_index);
+
     Num3DGridReadToMemory = 0;
     for (nobs = nobs_prev; nobs < nobs_total; nobs++) {
 
+        UpdateArrivalIndex(&arrival_index, arrival, nobs);
+
         if (message_flag >= 3) {
             sprintf(MsgStr, "Checking Arrival %d:  %s (%s)  %s %s %s %d",
                     nobs,
@@ -1526,7 +1572,7 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
             /* try finding previously initialized companion phase */
             if (IsPhaseID(arrival_phase, "S") &&
                     (n_compan =
-                    IsSameArrival(arrival, nobs, nobs, "P")) >= 0 &&
+                    IsSameArrivalIndexed(&arrival_index, nobs, "P")) >= 0 &&
                     arrival[n_compan].flag_ignore == 0) {
                 arrival[nobs].tfact = VpVsRatio;
                 arrival[nobs].gdesc.type = arrival[n_compan].gdesc.type;
@@ -1546,7 +1592,7 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
         /* if MODE_DIFFERENTIAL, check for same station phase, its time grid will be used for times */
         if (nll_mode == MODE_DIFFERENTIAL && arrival[nobs].n_companion < 0) {
             /* try finding previously initialized companion phase */
-            if ((n_compan = IsSameArrival(arrival, nobs, nobs, NULL)) >= 0 &&
+            if ((n_compan = IsSameArrivalIndexed(&arrival_index, nobs, NULL)) >= 0 &&
                     arrival[n_compan].flag_ignore == 0) {
                 arrival[nobs].gdesc.type = arrival[n_compan].gdesc.type;
                 arrival[nobs].station = arrival[n_compan].station;
@@ -1645,7 +1691,7 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
 #endif
 
                         /* check if time grid already read */
-                        if ((n_time_grid = FindDuplicateTimeGrid(arrival, nobs, nobs)) >= 0 && arrival[n_time_grid].flag_ignore == 0) {
+                        if ((n_time_grid = FindDuplicateTimeGridIndexed(&arrival_index, nobs)) >= 0 && arrival[n_time_grid].flag_ignore == 0) {
                             arrival[nobs].gdesc.type = arrival[n_time_grid].gdesc.type;
                             arrival[nobs].sheetdesc = arrival[n_time_grid].sheetdesc;
                             arrival[nobs].station = *pstation;
@@ -1847,6 +1893,8 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
                 || (read_2d_sheets && arrival[nobs].gdesc.type == GRID_TIME_2D)) {
 
             arrival[nobs].sheetdesc = arrival[nobs].gdesc;
+            // sheets are decoded when read from a quantised grid file
+            arrival[nobs].sheetdesc.flagGridQuantised = IS_NOT_QUANTISED;
             //INGV ??
             //if (arrival[nobs].gdesc.numx > 1)
             arrival[nobs].sheetdesc.numx = 2;
@@ -1873,10 +1921,12 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
         }
 
 
-        /* read 3D grid into memory (3D grids for Metropolis or Octtree search) */
+        /* read 3D grid into memory (3D grids for Metropolis or Octtree search,
+        and for grid-search distributed over several threads) */
 
         //int XX_last = NumAllocations;
-        if ((SearchType == SEARCH_MET || SearchType == SEARCH_OCTTREE)
+        if ((SearchType == SEARCH_MET || SearchType == SEARCH_OCTTREE
+                || (SearchType == SEARCH_GRID && NumSearchThreads > 1))
                 && arrival[nobs].gdesc.type == GRID_TIME
                 && (MaxNum3DGridMemory < 0 || Num3DGridReadToMemory < MaxNum3DGridMemory)) {
 
@@ -6393,6 +6443,19 @@ int SetOutName(ArrivalDesc *arrival, char* out_file_root, char* out_file,
 
 }
 
+/** function to check if two arrival times are the same within arrival errors */
+
+static int isSameArrivalTime(ArrivalDesc *parr, ArrivalDesc *ptest) {
+
+    return (fabs(parr->sec - ptest->sec) <= ((parr->error + ptest->error) / 2.0)
+            && parr->min == ptest->min
+            && parr->hour == ptest->hour
+            && parr->day == ptest->day
+            && parr->month == ptest->month
+            && parr->year == ptest->year);
+
+}
+
 /** function to check for duplicate label and phase (and time) in arrival */
 
 int IsDuplicateArrival(ArrivalDesc *arrival, int num_arrivals, int ntest, int rejectOnlyForExactTimeMatch) {
@@ -6402,21 +6465,8 @@ int IsDuplicateArrival(ArrivalDesc *arrival, int num_arrivals, int ntest, int re
         if (narr != ntest
                 && !strcmp(arrival[narr].time_grid_label, arrival[ntest].time_grid_label)
                 && !strcmp(arrival[narr].phase, arrival[ntest].phase)) {
-            if (rejectOnlyForExactTimeMatch) {
-                if (fabs(arrival[narr].sec - arrival[ntest].sec) <=
-                        ((arrival[narr].error + arrival[ntest].error) / 2.0)) {
-                    if (arrival[narr].min == arrival[ntest].min &&
-                            arrival[narr].hour == arrival[ntest].hour &&
-                            arrival[narr].day == arrival[ntest].day &&
-                            arrival[narr].month == arrival[ntest].month &&
-                            arrival[narr].year == arrival[ntest].year
-                            )
-                        return (narr);
-                }
-            } else {
-
+            if (!rejectOnlyForExactTimeMatch || isSameArrivalTime(arrival + narr, arrival + ntest))
                 return (narr);
-            }
         }
     }
 
@@ -6471,39 +6521,257 @@ int FindDuplicateTimeGrid(ArrivalDesc *arrival, int num_arrivals, int ntest) {
 
 }
 
-/** function to perform grid search location */
+/* from Kernigham and Ritchie, C prog lang, 2nd ed, 1988, sec 6.6 */
 
-int LocGridSearch(int ngrid, int num_arr_total, int num_arr_loc,
-        ArrivalDesc *arrival,
-        GridDesc* ptgrid, GaussLocParams* gauss_par, HypoDesc * phypo) {
+/** function to form hash value of string for arrival index */
+
+static unsigned ArrivalIndexHash(char *str) {
+
+    unsigned hashval;
+
+    for (hashval = 0; *str != '\0'; str++)
+        hashval = (unsigned char) *str + 31 * hashval;
+
+    return (hashval % ARRIVAL_INDEX_HASHSIZE);
+}
+
+/** function to reset arrival index to empty */
+
+static void ResetArrivalIndex(ArrivalIndex *pindex) {
+
+    int n;
+
+    pindex->num_indexed = 0;
+    for (n = 0; n < ARRIVAL_INDEX_HASHSIZE; n++) {
+        pindex->label_head[n] = pindex->label_tail[n] = -1;
+        pindex->root_head[n] = pindex->root_tail[n] = -1;
+    }
+
+}
+
+/** function to free arrival index */
+
+static void FreeArrivalIndex(ArrivalIndex *pindex) {
+
+    free(pindex->label_next);
+    free(pindex->root_next);
+    pindex->label_next = pindex->root_next = NULL;
+    pindex->size_next = 0;
+    ResetArrivalIndex(pindex);
+    pindex->arrival = NULL;
+
+}
+
+/** function to add arrivals up to num_arrivals - 1 to arrival index
+ *
+ *  time grid label and time grid file root of arrivals already in index must not have changed
+ *  returns -1 if index could not be allocated, index is then empty and indexed checks scan all arrivals */
+
+static int UpdateArrivalIndex(ArrivalIndex *pindex, ArrivalDesc *arrival, int num_arrivals) {
+
+    int narr, *label_next, *root_next;
+    unsigned hashval;
+
+    if (arrival != pindex->arrival || pindex->num_indexed < 0 || num_arrivals < pindex->num_indexed) {
+        ResetArrivalIndex(pindex);
+        pindex->arrival = arrival;
+    }
+
+    if (num_arrivals > pindex->size_next) {
+        label_next = (int *) realloc(pindex->label_next, num_arrivals * sizeof (int));
+        if (label_next != NULL)
+            pindex->label_next = label_next;
+        root_next = (int *) realloc(pindex->root_next, num_arrivals * sizeof (int));
+        if (root_next != NULL)
+            pindex->root_next = root_next;
+        if (label_next == NULL || root_next == NULL) {
+            nll_putmsg(1, "WARNING: allocating arrival index, checking arrivals without index.");
+            pindex->num_indexed = -num_arrivals;
+            return (-1);
+        }
+        pindex->size_next = num_arrivals;
+    }
+
+    for (narr = pindex->num_indexed; narr < num_arrivals; narr++) {
+        hashval = ArrivalIndexHash(arrival[narr].time_grid_label);
+        pindex->label_next[narr] = -1;
+        if (pindex->label_tail[hashval] < 0)
+            pindex->label_head[hashval] = narr;
+        else
+            pindex->label_next[pindex->label_tail[hashval]] = narr;
+        pindex->label_tail[hashval] = narr;
+        hashval = ArrivalIndexHash(arrival[narr].fileroot);
+        pindex->root_next[narr] = -1;
+        if (pindex->root_tail[hashval] < 0)
+            pindex->root_head[hashval] = narr;
+        else
+            pindex->root_next[pindex->root_tail[hashval]] = narr;
+        pindex->root_tail[hashval] = narr;
+    }
+    pindex->num_indexed = num_arrivals;
+
+    return (0);
+
+}
+
+/** function to check for duplicate label and phase (and time) in indexed arrivals, same as IsDuplicateArrival() */
+
+static int IsDuplicateArrivalIndexed(ArrivalIndex *pindex, int ntest, int rejectOnlyForExactTimeMatch) {
+
+    int narr;
+    ArrivalDesc *arrival = pindex->arrival;
+
+    if (pindex->num_indexed < 0)
+        return (IsDuplicateArrival(arrival, -pindex->num_indexed, ntest, rejectOnlyForExactTimeMatch));
+
+    for (narr = pindex->label_head[ArrivalIndexHash(arrival[ntest].time_grid_label)]; narr >= 0; narr = pindex->label_next[narr]) {
+        if (narr != ntest
+                && !strcmp(arrival[narr].time_grid_label, arrival[ntest].time_grid_label)
+                && !strcmp(arrival[narr].phase, arrival[ntest].phase)) {
+            if (!rejectOnlyForExactTimeMatch || isSameArrivalTime(arrival + narr, arrival + ntest))
+                return (narr);
+        }
+    }
+
+    return (-1);
+
+}
+
+/** function to check for same label and phase in indexed arrivals, same as IsSameArrival() */
+
+static int IsSameArrivalIndexed(ArrivalIndex *pindex, int ntest, char *phase_test) {
+
+    int narr;
+    ArrivalDesc *arrival = pindex->arrival;
+
+    if (pindex->num_indexed < 0)
+        return (IsSameArrival(arrival, -pindex->num_indexed, ntest, phase_test));
+
+    for (narr = pindex->label_head[ArrivalIndexHash(arrival[ntest].time_grid_label)]; narr >= 0; narr = pindex->label_next[narr]) {
+        if (narr == ntest || strcmp(arrival[narr].time_grid_label, arrival[ntest].time_grid_label))
+            continue;
+        if (phase_test == NULL) {
+            if ((IsPhaseID(arrival[narr].phase, "P") && IsPhaseID(arrival[ntest].phase, "P"))
+                    || (IsPhaseID(arrival[narr].phase, "S") && IsPhaseID(arrival[ntest].phase, "S")))
+                return (narr);
+        } else if (IsPhaseID(arrival[narr].phase, phase_test)) {
+            return (narr);
+        }
+    }
+
+    return (-1);
+
+}
+
+/** function to find previous arrival with same time grid file root in indexed arrivals, same as FindDuplicateTimeGrid() */
+
+static int FindDuplicateTimeGridIndexed(ArrivalIndex *pindex, int ntest) {
+
+    int narr;
+    ArrivalDesc *arrival = pindex->arrival;
+
+    if (pindex->num_indexed < 0)
+        return (FindDuplicateTimeGrid(arrival, -pindex->num_indexed, ntest));
+
+    for (narr = pindex->root_head[ArrivalIndexHash(arrival[ntest].fileroot)]; narr >= 0; narr = pindex->root_next[narr]) {
+        if (narr != ntest
+                && !strcmp(arrival[narr].fileroot, arrival[ntest].fileroot)
+                && arrival[narr].flag_ignore == 0
+                )
+
+            return (narr);
+    }
+
+    return (-1);
+
+}
+
+/** function to check if solution quality can be evaluated concurrently for different hypocenters,
+ *  i.e. evaluation does not use shared state other than read-only data */
+
+static int isConcurrentEvalSafe(int num_arr_loc, ArrivalDesc *arrival) {
+
+    int narr;
+
+    if (LocMethod != METH_EDT && LocMethod != METH_EDT_BOX
+            && LocMethod != METH_GAU_ANALYTIC && LocMethod != METH_L1_NORM)
+        return (0);
+    // EDT_OT_WT_ML uses static work arrays
+    if (EDT_use_otime_weight == 2)
+        return (0);
+    if (iUseSearchPrior || iUseSearchPosterior)
+        return (0);
+    // verbose messages are written to shared buffer
+    if (message_flag > 3)
+        return (0);
+
+    for (narr = 0; narr < num_arr_loc; narr++) {
+        if (arrival[narr].n_companion >= 0) {
+            // companion travel time must be set before in getTravelTimes()
+            if (arrival[narr].n_companion >= narr)
+                return (0);
+        } else if (arrival[narr].gdesc.type == GRID_TIME) {
+            // time grids must be in memory, reading from file is not re-entrant
+            if (arrival[narr].gdesc.buffer == NULL || isCascadingGrid(&(arrival[narr].gdesc)))
+                return (0);
+        } else if (arrival[narr].sheetdesc.buffer == NULL) {
+            return (0);
+        }
+    }
+
+    return (1);
 
+}
+
+/** grid search over a slab of x-sheets, optionally distributed over NumSearchThreads threads
+ *
+ *  Each thread searches a contiguous range of x-sheets with its own copy of the arrivals.
+ *  Slab results are merged in x order, so the location and grid values do not depend on the number of threads.
+ */
+
+typedef struct {
+    int ngrid;
+    int num_arr_loc;
+    ArrivalDesc* arrival; // arrivals, private copy for all but first slab
+    GaussLocParams gauss_par; // gauss params, with own EDT matrix and EDT arrival data for all but first slab
+    EdtArrivalData edt_data; // EDT arrival data work arrays for all but first slab
+    GridDesc* ptgrid;
+    int ix_start, ix_end;
+    double xval_start;
+    // results
+    double sum;
+    double misfit_min, misfit_max;
+    int ix_best, iy_best, iz_best;
+    double x_best, y_best, z_best;
+    int numGridReject, numStaReject;
+    pthread_t thread;
+    int threaded;
+}
+GridSearchSlab;
+
+static void* LocGridSearch_slab(void* arg) {
+
+    GridSearchSlab* slab = (GridSearchSlab*) arg;
     int istat;
-    int ix = -1, iy = -1, iz = -1, narr;
+    int ix, iy, iz, narr;
     int iGridType;
-    int nReject, numGridReject = 0, numStaReject = 0;
+    int nReject;
     double xval, yval, zval;
-    /*double travel_time;*/
     double value;
     double misfit;
-    double misfit_min = VERY_LARGE_DOUBLE, misfit_max = -VERY_LARGE_DOUBLE;
     double dlike;
-
-
-
-    /* get solution quality at each grid point */
-
-    if (message_flag >= 4) {
-        nll_putmsg(4, "");
-        nll_putmsg(4, "Calculating solution over grid...");
-    }
+    int num_arr_loc = slab->num_arr_loc;
+    ArrivalDesc* arrival = slab->arrival;
+    GaussLocParams* gauss_par = &slab->gauss_par;
+    GridDesc* ptgrid = slab->ptgrid;
 
     iGridType = ptgrid->type;
 
-    xval = ptgrid->origx;
+    xval = slab->xval_start;
 
     /* loop over grid points */
 
-    for (ix = 0; ix < ptgrid->numx; ix++) {
+    for (ix = slab->ix_start; ix < slab->ix_end; ix++) {
 
         /* read y-z sheets for arrival travel-times (3D grids) */
         if ((istat = ReadArrivalSheets(num_arr_loc, arrival, xval)) < 0)
@@ -6533,8 +6801,8 @@ int LocGridSearch(int ngrid, int num_arr_total, int num_arr_loc,
 
                     if (nReject) {
 
-                        numGridReject++;
-                        numStaReject += nReject;
+                        slab->numGridReject++;
+                        slab->numStaReject += nReject;
                         misfit = -1.0;
                         value = 0.0;
                         if (iGridType == GRID_MISFIT)
@@ -6552,32 +6820,31 @@ int LocGridSearch(int ngrid, int num_arr_total, int num_arr_loc,
                                 arrival, gauss_par,
                                 iGridType, &misfit, NULL, NULL, 0.0, 0.0, 0.0, NULL, NULL, &log_prior);
                         if (iGridType == GRID_MISFIT) {
-                            ptgrid->sum += value;
+                            slab->sum += value;
                         } else if (iGridType == GRID_PROB_DENSITY) {
                             value += log_prior; // 20190513 AJL
                             dlike = exp(value);
-                            ptgrid->sum += dlike;
+                            slab->sum += dlike;
                             /* update  probabilistic residuals */
                             UpdateProbabilisticResiduals(num_arr_loc, arrival, dlike);
                         }
                         ((GRID_FLOAT_TYPE ***) ptgrid->array)[ix][iy][iz] = value;
 
                         /* check for minimum misfit */
-                        if (misfit < misfit_min) {
-                            misfit_min = misfit;
-                            phypo->misfit = misfit;
-                            phypo->ix = ix;
-                            phypo->iy = iy;
-                            phypo->iz = iz;
-                            phypo->x = xval;
-                            phypo->y = yval;
-                            phypo->z = zval;
+                        if (misfit < slab->misfit_min) {
+                            slab->misfit_min = misfit;
+                            slab->ix_best = ix;
+                            slab->iy_best = iy;
+                            slab->iz_best = iz;
+                            slab->x_best = xval;
+                            slab->y_best = yval;
+                            slab->z_best = zval;
                             for (narr = 0; narr < num_arr_loc; narr++)
                                 arrival[narr].pred_travel_time_best =
                                     arrival[narr].pred_travel_time;
                         }
-                        if (misfit > misfit_max)
-                            misfit_max = misfit;
+                        if (misfit > slab->misfit_max)
+                            slab->misfit_max = misfit;
 
                     }
                 }
@@ -6589,6 +6856,161 @@ int LocGridSearch(int ngrid, int num_arr_total, int num_arr_loc,
         xval += ptgrid->dx;
     }
 
+    return (NULL);
+
+}
+
+/** function to perform grid search location */
+
+int LocGridSearch(int ngrid, int num_arr_total, int num_arr_loc,
+        ArrivalDesc *arrival,
+        GridDesc* ptgrid, GaussLocParams* gauss_par, HypoDesc * phypo) {
+
+    int n, ix, narr, nrow;
+    int nthreads;
+    int iGridType;
+    int numGridReject = 0, numStaReject = 0;
+    double xval;
+    double misfit_min = VERY_LARGE_DOUBLE, misfit_max = -VERY_LARGE_DOUBLE;
+    GridSearchSlab* slabs;
+    GridSearchSlab* slab;
+
+
+
+    /* get solution quality at each grid point */
+
+    if (message_flag >= 4) {
+        nll_putmsg(4, "");
+        nll_putmsg(4, "Calculating solution over grid...");
+    }
+
+    iGridType = ptgrid->type;
+
+    // set up slabs, concurrent only if all data used is read-only
+    nthreads = NumSearchThreads;
+    if (nthreads > ptgrid->numx)
+        nthreads = ptgrid->numx;
+    if (nthreads > 1) {
+        // 2D grid sheets are read once and then shared by all slabs
+        if (ReadArrivalSheets(num_arr_loc, arrival, ptgrid->origx) < 0)
+            nll_puterr("ERROR: reading arrival travel time sheets.");
+        if (!isConcurrentEvalSafe(num_arr_loc, arrival)) {
+            nll_putmsg(2, "INFO: Grid search method or travel time grids do not support concurrent evaluation, using 1 thread.");
+            nthreads = 1;
+        }
+    }
+    if (nthreads < 1)
+        nthreads = 1;
+    if ((slabs = (GridSearchSlab*) calloc(nthreads, sizeof (GridSearchSlab))) == NULL) {
+        nll_puterr("ERROR: allocating grid search slabs.");
+        return (-1);
+    }
+
+    // private arrivals and EDT matrix for all but first slab
+    for (n = 1; n < nthreads; n++) {
+        slab = slabs + n;
+        slab->gauss_par = *gauss_par;
+        slab->gauss_par.EDTMtrx = NULL;
+        if ((slab->arrival = (ArrivalDesc*) malloc(num_arr_loc * sizeof (ArrivalDesc))) == NULL)
+            break;
+        memcpy(slab->arrival, arrival, num_arr_loc * sizeof (ArrivalDesc));
+        for (narr = 0; narr < num_arr_loc; narr++) {
+            slab->arrival[narr].pdf_residual_sum = 0.0;
+            slab->arrival[narr].pdf_weight_sum = 0.0;
+        }
+        // EDT matrix diagonal is modified during evaluation (Gauss2)
+        if (gauss_par->EDTMtrx != NULL) {
+            if ((slab->gauss_par.EDTMtrx = matrix_double(num_arr_loc, num_arr_loc)) == NULL)
+                break;
+            for (nrow = 0; nrow < num_arr_loc; nrow++)
+                memcpy(slab->gauss_par.EDTMtrx[nrow], gauss_par->EDTMtrx[nrow], num_arr_loc * sizeof (double));
+        }
+        if (gauss_par->EDTData != NULL) {
+            if (AllocEdtArrivalData(&slab->edt_data, num_arr_loc) < 0)
+                break;
+            slab->gauss_par.EDTData = &slab->edt_data;
+        }
+    }
+    if (n < nthreads) {
+        nll_puterr("WARNING: allocating grid search slabs, using 1 thread.");
+        for (n = 1; n < nthreads; n++) {
+            free_matrix_double(slabs[n].gauss_par.EDTMtrx, num_arr_loc, num_arr_loc);
+            FreeEdtArrivalData(&slabs[n].edt_data);
+            free(slabs[n].arrival);
+        }
+        nthreads = 1;
+    }
+
+    xval = ptgrid->origx;
+    for (n = 0; n < nthreads; n++) {
+        slab = slabs + n;
+        slab->ngrid = ngrid;
+        slab->num_arr_loc = num_arr_loc;
+        slab->ptgrid = ptgrid;
+        if (n == 0) {
+            slab->arrival = arrival;
+            slab->gauss_par = *gauss_par;
+        }
+        slab->ix_start = (ptgrid->numx * n) / nthreads;
+        slab->ix_end = (ptgrid->numx * (n + 1)) / nthreads;
+        slab->misfit_min = VERY_LARGE_DOUBLE;
+        slab->misfit_max = -VERY_LARGE_DOUBLE;
+        // accumulate x as in sequential search
+        slab->xval_start = xval;
+        for (ix = slab->ix_start; ix < slab->ix_end; ix++)
+            xval += ptgrid->dx;
+    }
+
+    for (n = 1; n < nthreads; n++) {
+        slab = slabs + n;
+        slab->threaded = pthread_create(&slab->thread, NULL, LocGridSearch_slab, slab) == 0;
+    }
+
+    // search first slab in calling thread, and any slabs for which no thread could be started
+    LocGridSearch_slab(slabs);
+    for (n = 1; n < nthreads; n++) {
+        slab = slabs + n;
+        if (slab->threaded)
+            pthread_join(slab->thread, NULL);
+        else
+            LocGridSearch_slab(slab);
+    }
+
+    /* merge slab results in x order */
+
+    for (n = 0; n < nthreads; n++) {
+        slab = slabs + n;
+        ptgrid->sum += slab->sum;
+        numGridReject += slab->numGridReject;
+        numStaReject += slab->numStaReject;
+        if (slab->misfit_min < misfit_min) {
+            misfit_min = slab->misfit_min;
+            phypo->misfit = slab->misfit_min;
+            phypo->ix = slab->ix_best;
+            phypo->iy = slab->iy_best;
+            phypo->iz = slab->iz_best;
+            phypo->x = slab->x_best;
+            phypo->y = slab->y_best;
+            phypo->z = slab->z_best;
+            if (slab->arrival != arrival) {
+                for (narr = 0; narr < num_arr_loc; narr++)
+                    arrival[narr].pred_travel_time_best = slab->arrival[narr].pred_travel_time_best;
+            }
+        }
+        if (slab->misfit_max > misfit_max)
+            misfit_max = slab->misfit_max;
+        if (slab->arrival != arrival) {
+            for (narr = 0; narr < num_arr_loc; narr++) {
+                arrival[narr].pdf_residual_sum += slab->arrival[narr].pdf_residual_sum;
+                arrival[narr].pdf_weight_sum += slab->arrival[narr].pdf_weight_sum;
+            }
+            free_matrix_double(slab->gauss_par.EDTMtrx, num_arr_loc, num_arr_loc);
+            FreeEdtArrivalData(&slab->edt_data);
+            free(slab->arrival);
+        }
+    }
+    free(slabs);
+
 
     /* give warning if grid points rejected */
 
@@ -6600,7 +7022,7 @@ int LocGridSearch(int ngrid, int num_arr_total, int num_arr_loc,
 
 
     /* construct search information string */
-    sprintf(phypo->searchInfo, "GRID nPts %d%c", ix * iy *iz, '\0');
+    sprintf(phypo->searchInfo, "GRID nPts %d%c", ptgrid->numx * ptgrid->numy * ptgrid->numz, '\0');
     /* write message */
     /*nll_putmsg(2, phypo->searchInfo);*/
 
@@ -6619,14 +7041,40 @@ int LocGridSearch(int ngrid, int num_arr_total, int num_arr_loc,
 
 
 
-/** function to perform Metropolis location */
+/** Metropolis random walk chains, optionally several independent chains distributed over NumSearchThreads threads
+ *
+ *  Chains other than the first start at a random point in the search grid and draw from their own random number stream,
+ *  seeded from the stream of the calling thread, so results do not depend on the number of threads.
+ */
+
+typedef struct {
+    int ichain;
+    int num_arr_loc;
+    ArrivalDesc* arrival; // arrivals, private copy for all but first chain
+    GaussLocParams gauss_par; // gauss params, with own EDT matrix and EDT arrival data for all but first chain
+    EdtArrivalData edt_data; // EDT arrival data work arrays for all but first chain
+    WalkParams* pMetrop;
+    WalkParams metrop; // walk params for all but first chain
+    GridDesc* ptgrid;
+    int num_samples; // number of accepted samples for this chain
+    int seed; // seed of random number stream, < 0 to continue stream of calling thread
+    float* fdata; // saved samples, may be NULL
+    SampleStatistics* pstats; // statistics of saved samples, may be NULL
+    // results
+    long int ngenerated;
+    int nSamples;
+    int nScatterSaved;
+    int numClipped, numGridReject, numStaReject;
+    int iAbort;
+    char abortMsg[2 * MAXLINE];
+    double misfit_min, misfit_max;
+    double x_best, y_best, z_best;
+}
+MetChain;
 
 #define MAX_NUM_MET_TRIES 1000
 
-int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
-        ArrivalDesc *arrival,
-        GridDesc* ptgrid, GaussLocParams* gauss_par, HypoDesc* phypo,
-        WalkParams* pMetrop, float* fdata) {
+static void LocMetropolis_chain(MetChain* chain) {
 
     int istat;
     int ntry, nSamples, nSampStat, narr, ipos;
@@ -6634,9 +7082,7 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
     int maxNumTries;
     int writeMessage = 0;
     int iGridType;
-    int nReject, numClipped = 0, numGridReject = 0, numStaReject = 0;
-    int iAbort = 0, iReject = 0;
-    int iBoundary = 0;
+    int nReject;
     int iAccept, numAcceptDeepMinima = 0;
     double xval, yval, zval;
     double currentMetStepFact;
@@ -6644,26 +7090,24 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
     double value, dlike, dlike_max = -VERY_LARGE_DOUBLE;
 
     double misfit;
-    double misfit_min = VERY_LARGE_DOUBLE, misfit_max = -VERY_LARGE_DOUBLE;
 
     double xmin, xmax, ymin, ymax, zmin, zmax;
-    double dx_init, dx_test;
-
-    int nScatterSaved;
+    double dx_test;
 
     double xmean_sum = 0.0, ymean_sum = 0.0, zmean_sum = 0.0;
     double xvar_sum = 0.0, yvar_sum = 0.0, zvar_sum = 0.0;
     double xvar = 0.0, yvar = 0.0, zvar = 0.0;
     double dsamp = 0.0, dsamp2;
 
+    UniState rand_state_save;
 
+    int num_arr_loc = chain->num_arr_loc;
+    ArrivalDesc* arrival = chain->arrival;
+    GaussLocParams* gauss_par = &chain->gauss_par;
+    WalkParams* pMetrop = chain->pMetrop;
+    GridDesc* ptgrid = chain->ptgrid;
+    float* fdata = chain->fdata;
 
-    /* get solution quality at each sample on random walk */
-
-    if (message_flag >= 4) {
-        nll_putmsg(4, "");
-        nll_putmsg(4, "Calculating solution along Metropolis walk...");
-    }
 
     iGridType = GRID_PROB_DENSITY;
 
@@ -6675,21 +7119,31 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
     zmin = ptgrid->origz;
     zmax = zmin + (double) (ptgrid->numz - 1) * ptgrid->dz;
 
+    /* use own random number stream, start at random point */
+    if (chain->seed >= 0) {
+        uni_get_state(&rand_state_save);
+        rinit(chain->seed);
+        pMetrop->x = get_rand_double(xmin, xmax);
+        pMetrop->y = get_rand_double(ymin, ymax);
+        pMetrop->z = get_rand_double(zmin, zmax);
+    }
+
     /* save intiial values */
     currentMetStepFact = MetStepFact;
-    dx_init = pMetrop->dx;
+
+    chain->misfit_min = VERY_LARGE_DOUBLE;
+    chain->misfit_max = -VERY_LARGE_DOUBLE;
 
 
     /* loop over walk samples */
 
     nSamples = 0;
     nSampStat = 0;
-    nScatterSaved = 0;
     ipos = 0;
     ntry = 0;
     ngenerated = 0;
     maxNumTries = MAX_NUM_MET_TRIES;
-    while (nSamples < MetNumSamples
+    while (nSamples < chain->num_samples
             && (nSamples <= MetLearn || ntry < maxNumTries)) {
 
         ntry++;
@@ -6698,7 +7152,7 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
                 xmin, xmax, ymin, ymax,
                 zmin, zmax, &xval, &yval, &zval);
         if (nSamples > MetEquil && istat > 0)
-            numClipped += istat;
+            chain->numClipped += istat;
 
         /* get travel times for observed arrivals */
 
@@ -6712,8 +7166,8 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
             nReject = getTravelTimes(arrival, num_arr_loc, xval, yval, zval);
 
             if (nReject) {
-                numGridReject++;
-                numStaReject += nReject;
+                chain->numGridReject++;
+                chain->numStaReject += nReject;
                 misfit = -1.0;
                 dlike = 0.0;
             } else {
@@ -6762,19 +7216,18 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
                     nSamples++;
 
                     /* check for minimum misfit */
-                    if (misfit < misfit_min) {
-                        misfit_min = misfit;
+                    if (misfit < chain->misfit_min) {
+                        chain->misfit_min = misfit;
                         dlike_max = dlike;
-                        phypo->misfit = misfit;
-                        phypo->x = xval;
-                        phypo->y = yval;
-                        phypo->z = zval;
+                        chain->x_best = xval;
+                        chain->y_best = yval;
+                        chain->z_best = zval;
                         for (narr = 0; narr < num_arr_loc; narr++)
                             arrival[narr].pred_travel_time_best =
                                 arrival[narr].pred_travel_time;
                     }
-                    if (misfit > misfit_max)
-                        misfit_max = misfit;
+                    if (misfit > chain->misfit_max)
+                        chain->misfit_max = misfit;
 
                     /* update sample location */
                     pMetrop->x = xval;
@@ -6824,10 +7277,14 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
                             && nSamples % MetSkip == 0) {
 
                         /* save sample to scatter file */
-                        fdata[ipos++] = xval;
-                        fdata[ipos++] = yval;
-                        fdata[ipos++] = zval;
-                        fdata[ipos++] = dlike;
+                        if (fdata != NULL) {
+                            fdata[ipos++] = xval;
+                            fdata[ipos++] = yval;
+                            fdata[ipos++] = zval;
+                            fdata[ipos++] = dlike;
+                        }
+                        if (chain->pstats != NULL)
+                            AddSampleStatistics(chain->pstats, (float) xval, (float) yval, (float) zval);
 
                         /* update  probabilitic residuals */
                         if (1)
@@ -6835,7 +7292,7 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
                                 num_arr_loc, arrival, 1.0);
 
 
-                        nScatterSaved++;
+                        chain->nScatterSaved++;
                     }
 
                     if (nSamples % 1000 == 1
@@ -6862,49 +7319,303 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
 
         /* failure to accept sample after maxNumTries */
         if (nSamples > MetLearn && ntry >= maxNumTries) {
-            sprintf(MsgStr,
+            sprintf(chain->abortMsg,
                     "ERROR: failed to accept new Metropolis sample after %d tries, aborting location.", ntry);
-            nll_puterr(MsgStr);
-            sprintf(phypo->locStatComm, "%s", MsgStr);
-            iAbort = 1;
+            chain->iAbort = 1;
             break;
         }
 
         /* maximum likelihood too low after learning stage */
         if (nSamples == MetLearn && dlike_max < MetProbMin) {
-            sprintf(MsgStr,
+            sprintf(chain->abortMsg,
                     "ERROR: after learning stage (%d samples), best probability = %.2le is less than ProbMin = %.2le, aborting location.",
                     MetLearn, dlike_max, MetProbMin);
-            nll_puterr(MsgStr);
-            sprintf(phypo->locStatComm, "%s", MsgStr);
-            iAbort = 1;
+            chain->iAbort = 1;
             break;
         }
 
     }
 
+    chain->nSamples = nSamples;
+    chain->ngenerated = ngenerated;
 
-    /* give warning if sample points clipped */
+    if (chain->seed >= 0)
+        uni_set_state(&rand_state_save);
 
-    if (numClipped > 0) {
-        sprintf(MsgStr, "WARNING: %d Metropolis samples clipped at search grid boundary.",
-                numClipped);
-        nll_putmsg(1, MsgStr);
-    }
+}
 
+typedef struct {
+    MetChain* chains;
+    int nchains;
+    int ithread;
+    int nthreads;
+    pthread_t thread;
+}
+MetChainWorker;
 
-    /* give warning if grid points rejected */
+/** function to run the chains ithread, ithread + nthreads, ... of one thread */
 
-    if (numGridReject > 0) {
-        sprintf(MsgStr, "WARNING: %d Metropolis samples rejected; travel times for an average of %.2lf arrival observations were not valid.",
-                numGridReject, (double) numStaReject / numGridReject);
-        nll_putmsg(1, MsgStr);
-    }
+static void* LocMetropolis_run(void* arg) {
 
+    MetChainWorker* worker = (MetChainWorker*) arg;
+    int n;
 
-    /* check reject location conditions */
+    for (n = worker->ithread; n < worker->nchains; n += worker->nthreads)
+        LocMetropolis_chain(worker->chains + n);
 
-    /* maximum like hypo on edge of grid */
+    return (NULL);
+
+}
+
+/** function to get maximum number of samples saved by a Metropolis search */
+
+int MetNumSavedMax(void) {
+
+    int nchains = MetNumChains > 1 ? MetNumChains : 1;
+
+    return (nchains * (1 + ((MetUse + nchains - 1) / nchains) / MetSkip));
+
+}
+
+/** function to perform Metropolis location */
+
+int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
+        ArrivalDesc *arrival,
+        GridDesc* ptgrid, GaussLocParams* gauss_par, HypoDesc* phypo,
+        WalkParams* pMetrop, float* fdata) {
+
+    int n, narr, nrow, ipos, isamp;
+    int nchains, nthreads;
+    int iGridType;
+    int iAbort = 0, iReject = 0;
+    int iBoundary = 0;
+    long int ngenerated = 0;
+    int nSamples = 0, nScatterSaved = 0, numClipped = 0, numGridReject = 0, numStaReject = 0;
+    int nChainSaveMax;
+    double misfit_min = VERY_LARGE_DOUBLE, misfit_max = -VERY_LARGE_DOUBLE;
+    double dx_init;
+    MetChain* chains;
+    MetChain* chain;
+    MetChainWorker* workers = NULL;
+
+
+
+    /* get solution quality at each sample on random walk */
+
+    if (message_flag >= 4) {
+        nll_putmsg(4, "");
+        nll_putmsg(4, "Calculating solution along Metropolis walk...");
+    }
+
+    iGridType = GRID_PROB_DENSITY;
+
+    /* save intiial values */
+    dx_init = pMetrop->dx;
+
+    nchains = MetNumChains > 1 ? MetNumChains : 1;
+    if ((chains = (MetChain*) calloc(nchains, sizeof (MetChain))) == NULL) {
+        nll_puterr("ERROR: allocating Metropolis chains.");
+        return (-1);
+    }
+
+    // first chain continues walk and random number stream of calling thread
+    chain = chains;
+    chain->num_arr_loc = num_arr_loc;
+    chain->arrival = arrival;
+    chain->gauss_par = *gauss_par;
+    chain->pMetrop = pMetrop;
+    chain->ptgrid = ptgrid;
+    chain->num_samples = MetNumSamples;
+    chain->seed = -1;
+    chain->fdata = fdata;
+    chain->pstats = &scatter_statistics;
+
+    // further chains, samples after start save are divided between chains
+    if (nchains > 1) {
+        nChainSaveMax = 1 + ((MetUse + nchains - 1) / nchains) / MetSkip;
+        for (n = 0; n < nchains; n++) {
+            chain = chains + n;
+            chain->ichain = n;
+            chain->num_samples = MetStartSave + (MetUse + nchains - 1) / nchains;
+            chain->pstats = NULL;
+            if ((chain->fdata = (float*) malloc(nChainSaveMax * 4 * sizeof (float))) == NULL)
+                break;
+            if (n == 0)
+                continue;
+            chain->num_arr_loc = num_arr_loc;
+            chain->ptgrid = ptgrid;
+            chain->metrop = *pMetrop;
+            chain->pMetrop = &chain->metrop;
+            chain->seed = get_rand_int(0, 900000000);
+            chain->gauss_par = *gauss_par;
+            chain->gauss_par.EDTMtrx = NULL;
+            if ((chain->arrival = (ArrivalDesc*) malloc(num_arr_loc * sizeof (ArrivalDesc))) == NULL)
+                break;
+            memcpy(chain->arrival, arrival, num_arr_loc * sizeof (ArrivalDesc));
+            for (narr = 0; narr < num_arr_loc; narr++) {
+                chain->arrival[narr].pdf_residual_sum = 0.0;
+                chain->arrival[narr].pdf_weight_sum = 0.0;
+            }
+            // EDT matrix diagonal is modified during evaluation (Gauss2)
+            if (gauss_par->EDTMtrx != NULL) {
+                if ((chain->gauss_par.EDTMtrx = matrix_double(num_arr_loc, num_arr_loc)) == NULL)
+                    break;
+                for (nrow = 0; nrow < num_arr_loc; nrow++)
+                    memcpy(chain->gauss_par.EDTMtrx[nrow], gauss_par->EDTMtrx[nrow], num_arr_loc * sizeof (double));
+            }
+            if (gauss_par->EDTData != NULL) {
+                if (AllocEdtArrivalData(&chain->edt_data, num_arr_loc) < 0)
+                    break;
+                chain->gauss_par.EDTData = &chain->edt_data;
+            }
+        }
+        if (n < nchains) {
+            nll_puterr("ERROR: allocating Metropolis chains.");
+            for (n = 0; n < nchains; n++) {
+                free(chains[n].fdata);
+                if (n > 0) {
+                    free_matrix_double(chains[n].gauss_par.EDTMtrx, num_arr_loc, num_arr_loc);
+                    FreeEdtArrivalData(&chains[n].edt_data);
+                    free(chains[n].arrival);
+                }
+            }
+            free(chains);
+            return (-1);
+        }
+    }
+
+    // run chains, concurrently only if all data used is read-only
+    nthreads = NumSearchThreads < nchains ? NumSearchThreads : nchains;
+    if (nthreads > 1 && !isConcurrentEvalSafe(num_arr_loc, arrival)) {
+        nll_putmsg(2, "INFO: Metropolis search method or travel time grids do not support concurrent evaluation, using 1 thread.");
+        nthreads = 1;
+    }
+    if (nthreads > 1)
+        workers = (MetChainWorker*) calloc(nthreads, sizeof (MetChainWorker));
+    if (workers == NULL) {
+        for (n = 0; n < nchains; n++)
+            LocMetropolis_chain(chains + n);
+    } else {
+        for (n = 0; n < nthreads; n++) {
+            workers[n].chains = chains;
+            workers[n].nchains = nchains;
+            workers[n].ithread = n;
+            workers[n].nthreads = nthreads;
+        }
+        // chains of threads which could not be started are run by the calling thread
+        for (n = 1; n < nthreads; n++) {
+            if (pthread_create(&workers[n].thread, NULL, LocMetropolis_run, workers + n) != 0)
+                workers[n].nthreads = 0;
+        }
+        LocMetropolis_run(workers);
+        for (n = 1; n < nthreads; n++) {
+            if (workers[n].nthreads > 0)
+                pthread_join(workers[n].thread, NULL);
+            else {
+                workers[n].nthreads = nthreads;
+                LocMetropolis_run(workers + n);
+            }
+        }
+        free(workers);
+    }
+
+
+    /* merge chain results in chain order */
+
+    ipos = 0;
+    for (n = 0; n < nchains; n++) {
+        chain = chains + n;
+        ngenerated += chain->ngenerated;
+        nSamples += chain->nSamples;
+        numClipped += chain->numClipped;
+        numGridReject += chain->numGridReject;
+        numStaReject += chain->numStaReject;
+        if (chain->iAbort && !iAbort) {
+            nll_puterr(chain->abortMsg);
+            sprintf(phypo->locStatComm, "%s", chain->abortMsg);
+            iAbort = 1;
+        }
+        if (chain->misfit_min < misfit_min) {
+            misfit_min = chain->misfit_min;
+            phypo->misfit = chain->misfit_min;
+            phypo->x = chain->x_best;
+            phypo->y = chain->y_best;
+            phypo->z = chain->z_best;
+            if (chain->arrival != arrival) {
+                for (narr = 0; narr < num_arr_loc; narr++)
+                    arrival[narr].pred_travel_time_best = chain->arrival[narr].pred_travel_time_best;
+            }
+        }
+        if (chain->misfit_max > misfit_max)
+            misfit_max = chain->misfit_max;
+        if (nchains > 1) {
+            // combined scatter sample and statistics
+            for (isamp = 0; isamp < 4 * chain->nScatterSaved; isamp += 4) {
+                AddSampleStatistics(&scatter_statistics,
+                        chain->fdata[isamp], chain->fdata[isamp + 1], chain->fdata[isamp + 2]);
+                if (fdata != NULL) {
+                    fdata[ipos++] = chain->fdata[isamp];
+                    fdata[ipos++] = chain->fdata[isamp + 1];
+                    fdata[ipos++] = chain->fdata[isamp + 2];
+                    fdata[ipos++] = chain->fdata[isamp + 3];
+                }
+            }
+        }
+        nScatterSaved += chain->nScatterSaved;
+        if (chain->arrival != arrival) {
+            for (narr = 0; narr < num_arr_loc; narr++) {
+                arrival[narr].pdf_residual_sum += chain->arrival[narr].pdf_residual_sum;
+                arrival[narr].pdf_weight_sum += chain->arrival[narr].pdf_weight_sum;
+            }
+        }
+    }
+
+    // convergence of chains
+    phypo->nChains = nchains;
+    if (nchains > 1) {
+        float* chain_fdata[nchains];
+        int chain_nsamples[nchains];
+        for (n = 0; n < nchains; n++) {
+            chain_fdata[n] = chains[n].fdata;
+            chain_nsamples[n] = chains[n].nScatterSaved;
+        }
+        phypo->rhat = CalcGelmanRubinSamples(chain_fdata, chain_nsamples, nchains);
+    }
+
+    for (n = 0; n < nchains; n++) {
+        chain = chains + n;
+        if (nchains > 1)
+            free(chain->fdata);
+        if (chain->arrival != arrival) {
+            free_matrix_double(chain->gauss_par.EDTMtrx, num_arr_loc, num_arr_loc);
+            FreeEdtArrivalData(&chain->edt_data);
+            free(chain->arrival);
+        }
+    }
+    free(chains);
+
+
+    /* give warning if sample points clipped */
+
+    if (numClipped > 0) {
+        sprintf(MsgStr, "WARNING: %d Metropolis samples clipped at search grid boundary.",
+                numClipped);
+        nll_putmsg(1, MsgStr);
+    }
+
+
+    /* give warning if grid points rejected */
+
+    if (numGridReject > 0) {
+        sprintf(MsgStr, "WARNING: %d Metropolis samples rejected; travel times for an average of %.2lf arrival observations were not valid.",
+                numGridReject, (double) numStaReject / numGridReject);
+        nll_putmsg(1, MsgStr);
+    }
+
+
+    /* check reject location conditions */
+
+    /* maximum like hypo on edge of grid */
     if ((iBoundary = isOnGridBoundary(phypo->x, phypo->y, phypo->z,
             ptgrid, pMetrop->dx, pMetrop->dx, 0))) {
         sprintf(MsgStr, "WARNING: max prob location on grid boundary %d, rejecting location.", iBoundary);
@@ -6917,6 +7628,11 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
     sprintf(phypo->searchInfo,
             "METROPOLIS nSamp %ld nAcc %d nSave %d nClip %d Dstep0 %lf Dstep %lf%c",
             ngenerated, nSamples, nScatterSaved, numClipped, dx_init, pMetrop->dx, '\0');
+    if (nchains > 1) {
+        char chains_text[128];
+        sprintf(chains_text, " nChains %d Rhat %lf %lf %lf", nchains, phypo->rhat.x, phypo->rhat.y, phypo->rhat.z);
+        strcat(phypo->searchInfo, chains_text);
+    }
     /* write message */
     nll_putmsg(2, phypo->searchInfo);
 
@@ -7257,6 +7973,10 @@ int ReadArrivalSheets(int num_arrivals, ArrivalDesc *arrival, double xsheet) {
         if (arrival[narr].n_companion >= 0)
             continue;
 
+        /* skip sheet read if 3D grid is in memory, travel times are read from grid buffer */
+        if (arrival[narr].gdesc.type == GRID_TIME && arrival[narr].gdesc.buffer != NULL)
+            continue;
+
         /* skip sheet read or set xsheet to zero for 2D grid */
         if (arrival[narr].gdesc.type == GRID_TIME_2D) {
             if (arrival[narr].sheetdesc.origx < LARGE_DOUBLE)
@@ -7347,6 +8067,140 @@ int ReadArrivalSheets(int num_arrivals, ArrivalDesc *arrival, double xsheet) {
 
 }
 
+/** function to free EDT arrival pair index */
+
+static void FreeEdtPairIndex(EdtPairIndex *pindex) {
+
+    free(pindex->pair_start);
+    free(pindex->pair_col);
+    free(pindex->pair_corr);
+    free(pindex->pair_sta_weight);
+    free(pindex->pair_prior_weight);
+    free(pindex->pair_weight2);
+    free(pindex->pair_weight);
+    memset(pindex, 0, sizeof (EdtPairIndex));
+}
+
+/** function to allocate EDT arrival data work arrays for num_arrivals arrivals, arrays already large enough are kept */
+
+static int AllocEdtArrivalData(EdtArrivalData *pdata, int num_arrivals) {
+
+    int size;
+
+    if (pdata->active != NULL && pdata->size >= num_arrivals)
+        return (0);
+
+    FreeEdtArrivalData(pdata);
+    size = num_arrivals > 0 ? num_arrivals : 1;
+    pdata->active = (int *) malloc((size_t) size * sizeof (int));
+    pdata->obs_centered = (double *) malloc(4 * (size_t) size * sizeof (double));
+    if (pdata->active == NULL || pdata->obs_centered == NULL) {
+        FreeEdtArrivalData(pdata);
+        return (-1);
+    }
+    pdata->pred_centered = pdata->obs_centered + size;
+    pdata->sigma2 = pdata->obs_centered + 2 * size;
+    pdata->amplitude = pdata->obs_centered + 3 * size;
+    pdata->size = size;
+
+    return (0);
+}
+
+/** function to free EDT arrival data work arrays */
+
+static void FreeEdtArrivalData(EdtArrivalData *pdata) {
+
+    free(pdata->active);
+    free(pdata->obs_centered);
+    memset(pdata, 0, sizeof (EdtArrivalData));
+}
+
+/** function to check if a pair of arrivals is used in EDT misfit */
+
+static int isEdtPair(ArrivalDesc *arrival, int nrow, int ncol) {
+
+    // arrivals without absolute timing only pair with arrivals at same sta/inst without absolute timing
+    if (!arrival[nrow].abs_time) {
+        if (arrival[ncol].abs_time)
+            return (0);
+        if (strcmp(arrival[nrow].label, arrival[ncol].label) != 0
+                || strcmp(arrival[nrow].inst, arrival[ncol].inst) != 0)
+            return (0);
+    }
+
+    return (1);
+}
+
+/** function to construct EDT arrival pair index
+ *
+ *  pair selection and pair weight factors do not depend on location, they are set here once
+ *  instead of for each pair of each evaluated location in CalcSolutionQuality_EDT()
+ */
+
+static int ConstEdtPairIndex(int num_arrivals, ArrivalDesc *arrival, MatrixDouble edtmtx, EdtPairIndex *pindex) {
+
+    int nrow, ncol, npair, num_pairs;
+    double weight;
+
+    FreeEdtPairIndex(pindex);
+    pindex->num_arrivals = num_arrivals;
+
+    num_pairs = 0;
+    for (nrow = 0; nrow < num_arrivals; nrow++)
+        for (ncol = nrow + 1; ncol < num_arrivals; ncol++)
+            num_pairs += isEdtPair(arrival, nrow, ncol);
+
+    pindex->pair_start = (int *) malloc((size_t) (num_arrivals + 1) * sizeof (int));
+    pindex->pair_col = (int *) malloc((size_t) (num_pairs + 1) * sizeof (int));
+    pindex->pair_corr = (double *) malloc((size_t) (num_pairs + 1) * sizeof (double));
+    pindex->pair_sta_weight = (double *) malloc((size_t) (num_pairs + 1) * sizeof (double));
+    pindex->pair_prior_weight = (double *) malloc((size_t) (num_pairs + 1) * sizeof (double));
+    if (pindex->pair_start == NULL || pindex->pair_col == NULL || pindex->pair_corr == NULL
+            || pindex->pair_sta_weight == NULL || pindex->pair_prior_weight == NULL) {
+        FreeEdtPairIndex(pindex);
+        return (-1);
+    }
+    // with LOCGAU2 travel time errors the pair weights depend on location
+    if (!iUseGauss2) {
+        pindex->pair_weight2 = (double *) malloc((size_t) (num_pairs + 1) * sizeof (double));
+        pindex->pair_weight = (double *) malloc((size_t) (num_pairs + 1) * sizeof (double));
+        if (pindex->pair_weight2 == NULL || pindex->pair_weight == NULL) {
+            FreeEdtPairIndex(pindex);
+            return (-1);
+        }
+    }
+
+    npair = 0;
+    for (nrow = 0; nrow < num_arrivals; nrow++) {
+        pindex->pair_start[nrow] = npair;
+        for (ncol = nrow + 1; ncol < num_arrivals; ncol++) {
+            if (!isEdtPair(arrival, nrow, ncol))
+                continue;
+            pindex->pair_col[npair] = ncol;
+            pindex->pair_corr[npair] = 1.0 - edtmtx[nrow][ncol]; // correlation coeff
+            pindex->pair_sta_weight[npair] = sqrt(arrival[nrow].station_weight * arrival[ncol].station_weight);
+            pindex->pair_prior_weight[npair] = 1.0;
+            if (iUseArrivalPriorWeights && arrival[nrow].apriori_weight >= -VERY_SMALL_DOUBLE && arrival[ncol].apriori_weight >= -VERY_SMALL_DOUBLE)
+                pindex->pair_prior_weight[npair] = sqrt(arrival[nrow].apriori_weight * arrival[ncol].apriori_weight);
+            if (pindex->pair_weight2 != NULL) {
+                // same operations as in CalcSolutionQuality_EDT()
+                pindex->pair_weight2[npair] = 1.0 / (edtmtx[nrow][nrow] + edtmtx[ncol][ncol]); // sum of errors**2
+                weight = sqrt(pindex->pair_weight2[npair]); // errors factor
+                weight *= pindex->pair_corr[npair];
+                if (iSetStationDistributionWeights)
+                    weight *= pindex->pair_sta_weight[npair];
+                if (iUseArrivalPriorWeights)
+                    weight *= pindex->pair_prior_weight[npair];
+                pindex->pair_weight[npair] = weight;
+            }
+            npair++;
+        }
+    }
+    pindex->pair_start[num_arrivals] = npair;
+
+    return (0);
+}
+
 /** function to construct weight matrix (inverse of covariance matrix) */
 
 int ConstWeightMatrix(int num_arrivals, ArrivalDesc *arrival, GaussLocParams * gauss_par) {
@@ -7537,6 +8391,22 @@ int ConstWeightMatrix(int num_arrivals, ArrivalDesc *arrival, GaussLocParams * g
     }
 
 
+    // EDT arrival pairs and arrival data work arrays of calling thread
+    gauss_par->EDTPairs = NULL;
+    gauss_par->EDTData = NULL;
+    if (LocMethod == METH_EDT || LocMethod == METH_EDT_BOX) {
+        if (ConstEdtPairIndex(num_arrivals, arrival, edt_matrix, &edt_pair_index) < 0) {
+            nll_puterr("ERROR: allocating EDT arrival pair index.");
+            return (-1);
+        }
+        if (AllocEdtArrivalData(&edt_arrival_data, num_arrivals) < 0) {
+            nll_puterr("ERROR: allocating EDT arrival data arrays.");
+            return (-1);
+        }
+        gauss_par->EDTPairs = &edt_pair_index;
+        gauss_par->EDTData = &edt_arrival_data;
+    }
+
     // set global variables
     gauss_par->EDTMtrx = edt_matrix;
     gauss_par->WtMtrx = wt_matrix;
@@ -7560,6 +8430,8 @@ int CleanWeightMatrix() {
         free_matrix_double(wt_matrix, last_matrix_alloc_size, last_matrix_alloc_size);
     wt_matrix = NULL;
     last_matrix_alloc_size = -1;
+    FreeEdtPairIndex(&edt_pair_index);
+    FreeEdtArrivalData(&edt_arrival_data);
 
     return (0);
 
@@ -7993,11 +8865,12 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
     double ln_prob_density, rms_misfit;
 
     MatrixDouble edtmtx;
+    EdtPairIndex *edt_pairs;
+    EdtArrivalData *edt_data;
+    int npair, use_pair_weights;
     double sigma2_row;
     double obs_minus_pred;
 
-    int no_abs_time_row;
-
     // EDT_OT_WT
     int num_otime_error;
     long double ot_row, ot_prob, ot_row_2, ot_error_2;
@@ -8038,12 +8911,24 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
     }
 
     edtmtx = gauss_par->EDTMtrx;
+    edt_pairs = gauss_par->EDTPairs;
+    edt_data = gauss_par->EDTData;
+    if (edt_pairs == NULL || edt_pairs->num_arrivals != num_arrivals
+            || edt_data == NULL || edt_data->size < num_arrivals) {
+        nll_puterr("ERROR: EDT arrival pair index or arrival data not initialized for arrivals.");
+        // zero probability and maximum misfit, location is never selected by search
+        *pmisfit = VERY_LARGE_DOUBLE;
+        return (-VERY_LARGE_DOUBLE);
+    }
 
     // check if use_cell_diagonal_time_var
     iuse_cell_diagonal_time_var = 0;
     if (cell_diagonal_time_var > 0.0)
         iuse_cell_diagonal_time_var = 1;
 
+    // pair weights set in pair index can be used if errors do not depend on location
+    use_pair_weights = edt_pairs->pair_weight != NULL && !iuse_cell_diagonal_time_var && !method_box;
+
     // check size of EDT_OT_WT_ML static arrays
     if ((EDT_use_otime_weight == 2 || icalc_otime_default)) {
         if (isize_ot_ml_array < num_arrivals) {
@@ -8088,6 +8973,9 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
 #ifdef TEST_COUNT_ONLY_USED_ARRIVALS
     int num_arrivals_used = 0;
 #endif
+    // copy arrival data used for each pair of arrivals to structure-of-arrays, flag arrivals with predicted times,
+    //    Gauss2 errors are set here once for each arrival, not for each pair
+    int num_edt = 0;
     for (nrow = 0; nrow < num_arrivals; nrow++) {
 
         //printf("DEBUG: arrival[%d].pred_travel_time %f\n", nrow, arrival[nrow].pred_travel_time);
@@ -8098,13 +8986,11 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
             if (EDT_use_otime_weight == 2 || icalc_otime_default) {
                 ot_ml_arrival_edt_sum[nrow] = -1.0;
             }
+            edt_data->active[nrow] = 0;
             continue; // ignore obs without predicted times
         }
         // END
 
-#ifdef TEST_COUNT_ONLY_USED_ARRIVALS
-        num_arrivals_used++;
-#endif
         // set error
         //printf("iUseGauss2 %d\n", iUseGauss2);
         if (iUseGauss2) {
@@ -8119,9 +9005,25 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
             }
             tt_error *= tt_error;
             edtmtx[nrow][nrow] = arrival[nrow].error * arrival[nrow].error + tt_error;
-            sigma2_row = edtmtx[nrow][nrow];
         }
-        sigma2_row = edtmtx[nrow][nrow];
+
+        edt_data->active[nrow] = 1;
+        edt_data->obs_centered[nrow] = arrival[nrow].obs_centered;
+        edt_data->pred_centered[nrow] = arrival[nrow].pred_centered;
+        edt_data->sigma2[nrow] = edtmtx[nrow][nrow];
+        edt_data->amplitude[nrow] = arrival[nrow].amplitude;
+        num_edt++;
+    }
+#ifdef TEST_COUNT_ONLY_USED_ARRIVALS
+    num_arrivals_used = num_edt;
+#endif
+
+    for (nrow = 0; nrow < num_arrivals; nrow++) {
+
+        if (!edt_data->active[nrow])
+            continue;
+
+        sigma2_row = edt_data->sigma2[nrow];
 
         if (iuse_cell_diagonal_time_var)
             sigma2_row += cell_diagonal_time_var;
@@ -8129,9 +9031,8 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
         sigma2_row_search = edtmtx[nrow][nrow] + cell_diagonal_time_var;
 }*/
         //error_row = arrival[nrow].error;
-        amp_row = arrival[nrow].amplitude;
-        obs_minus_pred = arrival[nrow].obs_centered - arrival[nrow].pred_centered;
-        no_abs_time_row = !arrival[nrow].abs_time;
+        amp_row = edt_data->amplitude[nrow];
+        obs_minus_pred = edt_data->obs_centered[nrow] - edt_data->pred_centered[nrow];
         if (EDT_use_otime_weight == 2 || icalc_otime_default) { // EDT_OT_WT_ML or otime
             ot_ml_arrival[nrow] = arrival[nrow].obs_time - (long double) arrival[nrow].pred_travel_time;
             //ot_ml_arrival_edt_sum[nrow] = 0.0;
@@ -8144,71 +9045,44 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
             ot_error_2 += sigma2_row;
             num_otime_error++;
         }
-        for (ncol = nrow + 1; ncol < num_arrivals; ncol++) {
-            // AJL 20041115 bug fix!
-            if (arrival[ncol].pred_travel_time <= 0.0)
-                continue; // ignore obs without predicted times
-            // END
-            // check absolute timing
-            if (no_abs_time_row) {
-                if (arrival[ncol].abs_time) // cannot be same station/inst
-                    continue;
-                if (strcmp(arrival[nrow].label, arrival[ncol].label) != 0
-                        || strcmp(arrival[nrow].inst, arrival[ncol].inst) != 0)
-                    continue; // not same sta/inst
-            }
+        // pairs with absolute timing or same sta/inst, see ConstEdtPairIndex()
+        for (npair = edt_pairs->pair_start[nrow]; npair < edt_pairs->pair_start[nrow + 1]; npair++) {
+            ncol = edt_pairs->pair_col[npair];
+            if (!edt_data->active[ncol])
+                continue;
             // calculate EDT misfit:  (obs1 - obs2) - (pred1 - pred2)
-            edt_misfit = (double) (obs_minus_pred + arrival[ncol].pred_centered - arrival[ncol].obs_centered);
-            // set error
-            if (iUseGauss2) {
-                tt_error = arrival[ncol].pred_travel_time * Gauss2.SigmaTfraction;
-                if (tt_error < Gauss2.SigmaTmin)
-                    tt_error = Gauss2.SigmaTmin;
-                if (tt_error > Gauss2.SigmaTmax)
-                    tt_error = Gauss2.SigmaTmax;
-                tt_error *= tt_error;
-                edtmtx[ncol][ncol] = arrival[ncol].error * arrival[ncol].error + tt_error;
-            }
+            edt_misfit = (double) (obs_minus_pred + edt_data->pred_centered[ncol] - edt_data->obs_centered[ncol]);
             // calculate probability
-            if (method_box) {
-                unc_limit = amp_row + arrival[ncol].amplitude; // sum of mean pick unc for each box
-                //unc_limit = error_row + arrival[ncol].error;	// sum of box widths
-                prob = fabs(edt_misfit) <= unc_limit ? 1.0 : 0.0;
-                weight = amp_row * arrival[ncol].amplitude; // product of mean pick unc for each box
-                weight *= (1.0 - edtmtx[nrow][ncol]); // correlation coeff
+            if (use_pair_weights) {
+                // all weight factors set in pair index
+                prob = exp(-0.5 * edt_misfit * edt_misfit * edt_pairs->pair_weight2[npair]);
+                weight = edt_pairs->pair_weight[npair];
             } else {
-                if (iuse_cell_diagonal_time_var)
-                    weight2 = 1.0 / (sigma2_row + edtmtx[ncol][ncol] + cell_diagonal_time_var); // sum of errors**2
-                else
-                    weight2 = 1.0 / (sigma2_row + edtmtx[ncol][ncol]); // sum of errors**2
-                prob = exp(-0.5 * edt_misfit * edt_misfit * weight2);
-                weight = sqrt(weight2); // errors factor
-                weight *= (1.0 - edtmtx[nrow][ncol]); // correlation coeff
-                /*if (iuse_cell_diagonal_time_var) {	// duplicate above 4 lines
-                weight2_search = 1.0 / (sigma2_row_search + edtmtx[ncol][ncol] + cell_diagonal_time_var);	// sum of errors**2
-                prob_search = exp(-0.5 * edt_misfit * edt_misfit * weight2_search);
-                weight_search = sqrt(weight2_search);		// errors factor
-                weight_search *= (1.0 - edtmtx[nrow][ncol]);		// correlation coeff
-        }*/
+                if (method_box) {
+                    unc_limit = amp_row + edt_data->amplitude[ncol]; // sum of mean pick unc for each box
+                    //unc_limit = error_row + arrival[ncol].error;	// sum of box widths
+                    prob = fabs(edt_misfit) <= unc_limit ? 1.0 : 0.0;
+                    weight = amp_row * edt_data->amplitude[ncol]; // product of mean pick unc for each box
+                    weight *= edt_pairs->pair_corr[npair]; // correlation coeff
+                } else {
+                    if (iuse_cell_diagonal_time_var)
+                        weight2 = 1.0 / (sigma2_row + edt_data->sigma2[ncol] + cell_diagonal_time_var); // sum of errors**2
+                    else
+                        weight2 = 1.0 / (sigma2_row + edt_data->sigma2[ncol]); // sum of errors**2
+                    prob = exp(-0.5 * edt_misfit * edt_misfit * weight2);
+                    weight = sqrt(weight2); // errors factor
+                    weight *= edt_pairs->pair_corr[npair]; // correlation coeff
+                }
+                // 20130627 AJL - change weighing from sum to product
+                if (iSetStationDistributionWeights)
+                    weight *= edt_pairs->pair_sta_weight[npair];
+                // 20130627 AJL - add prior weighting as product
+                if (iUseArrivalPriorWeights)
+                    weight *= edt_pairs->pair_prior_weight[npair];
             }
-            // 20130627 AJL - change weighing from sum to product
-            //if (iSetStationDistributionWeights)
-            //    weight *= (arrival[nrow].station_weight + arrival[ncol].station_weight) / 2.0;
-            if (iSetStationDistributionWeights)
-                weight *= sqrt(arrival[nrow].station_weight * arrival[ncol].station_weight);
-            // 20130627 AJL - add prior weighting as product
-            if (iUseArrivalPriorWeights && arrival[nrow].apriori_weight >= -VERY_SMALL_DOUBLE && arrival[ncol].apriori_weight >= -VERY_SMALL_DOUBLE)
-                weight *= sqrt(arrival[nrow].apriori_weight * arrival[ncol].apriori_weight);
             prob *= weight;
             edt_sum += prob;
             edt_weight += weight;
-            /*if (iuse_cell_diagonal_time_var) {	// duplicate above 5 lines
-            if (iSetStationDistributionWeights)
-            weight_search *= (arrival[nrow].station_weight + arrival[ncol].station_weight) / 2.0;
-            prob_search *= weight_search;
-            edt_sum_search += prob_search;
-            edt_weight_search += weight_search;
-    }*/
             // accumulate EDT weights
             if (icalc_otime) {
                 //arrival[ncol].weight += weight;
@@ -8218,9 +9092,6 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
             }
             // otime
             if (EDT_use_otime_weight == 2 || icalc_otime_default) { // EDT_OT_WT_ML or otime
-                /*if (iuse_cell_diagonal_time_var)	// ???? TEST
-                ot_ml_arrival_edt_sum[nrow] += prob_search;
-                else*/
                 ot_ml_arrival_edt_sum[ncol] += prob;
                 // AJL 20070326 bug fix!
                 ot_ml_arrival_edt_sum[nrow] += prob;
@@ -8247,9 +9118,13 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
         ot_var_weight = -ot_ml_var / (ot_error_2 / (long double) num_otime_error);
         if (ot_var_weight > EDT_OT_WT_FLOOR) {
             if (!EDT_otime_weight_active) {
-                EDT_otime_weight_active = 1;
-                sprintf(MsgStr, "INFO: EDT_otime_weight activated, OT_WT exceeds EDT_OT_WT_FLOOR.");
-                nll_putmsg(2, MsgStr);
+                pthread_mutex_lock(&edt_otime_weight_mutex);
+                if (!EDT_otime_weight_active) {
+                    EDT_otime_weight_active = 1;
+                    sprintf(MsgStr, "INFO: EDT_otime_weight activated, OT_WT exceeds EDT_OT_WT_FLOOR.");
+                    nll_putmsg(2, MsgStr);
+                }
+                pthread_mutex_unlock(&edt_otime_weight_mutex);
             }
         } else {
             ot_var_weight = EDT_OT_WT_FLOOR;
@@ -8264,9 +9139,13 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
         ot_var_weight = -ot_var / (ot_error_2 / (long double) num_otime_error);
         if (ot_var_weight > EDT_OT_WT_FLOOR) {
             if (!EDT_otime_weight_active) {
-                EDT_otime_weight_active = 1;
-                sprintf(MsgStr, "INFO: EDT_otime_weight activated, OT_WT exceeds EDT_OT_WT_FLOOR.");
-                nll_putmsg(2, MsgStr);
+                pthread_mutex_lock(&edt_otime_weight_mutex);
+                if (!EDT_otime_weight_active) {
+                    EDT_otime_weight_active = 1;
+                    sprintf(MsgStr, "INFO: EDT_otime_weight activated, OT_WT exceeds EDT_OT_WT_FLOOR.");
+                    nll_putmsg(2, MsgStr);
+                }
+                pthread_mutex_unlock(&edt_otime_weight_mutex);
             }
         } else {
             ot_var_weight = EDT_OT_WT_FLOOR;
@@ -13224,38 +14103,125 @@ double Calc_MD_FMAG(double coda_dur, double dist, double depth, double sta_corr,
 /*------------------------------------------------------------/ */
 /** hashtable routines for accumulating station statistics */
 
-/* from Kernigham and Ritchie, C prog lang, 2nd ed, 1988, sec 6.6 */
+/* station statistics tables */
+static StaStatTable sta_stat_table[MAX_NUM_LOCATION_GRIDS];
 
-/** funtion to form ordered hash value from firt char of label */
+/** function to form output order value from first char of label */
 
-static unsigned hash(char* label, char* phase) {
+static unsigned staStatOrder(char* label) {
 
-    unsigned hashval;
+    unsigned order;
 
     if (isdigit(label[0]))
-        hashval = label[0] - '0';
+        order = label[0] - '0';
     else if (isalpha(label[0]))
-        hashval = 10 + toupper(label[0]) - 'A';
+        order = 10 + toupper(label[0]) - 'A';
     else
-        hashval = 36 + label[0] % 10;
+        order = 36 + label[0] % 10;
+
+    return order;
+}
+
+/** function to compare station statistics nodes for output: order value of label, label, phase */
+
+static int compareStaStatNodes(const void *pnode1, const void *pnode2) {
+
+    StaStatNode *np1 = *(StaStatNode **) pnode1;
+    StaStatNode *np2 = *(StaStatNode **) pnode2;
+    unsigned order1 = staStatOrder(np1->label);
+    unsigned order2 = staStatOrder(np2->label);
+    int icomp;
+
+    if (order1 != order2)
+        return (order1 < order2 ? -1 : 1);
+    if ((icomp = strcmp(np1->label, np2->label)) != 0)
+        return (icomp);
+    return (strcmp(np1->phase, np2->phase));
+}
+
+/** function to form hash value of label and phase (FNV-1a) */
+
+static unsigned hash(char* label, char* phase) {
+
+    unsigned hashval = 2166136261u;
 
-    hashval = hashval % HASHSIZE;
+    for (; *label != '\0'; label++)
+        hashval = (hashval ^ (unsigned char) *label) * 16777619u;
+    hashval = (hashval ^ (unsigned char) ' ') * 16777619u;
+    for (; *phase != '\0'; phase++)
+        hashval = (hashval ^ (unsigned char) *phase) * 16777619u;
 
     return hashval;
 }
 
+/** function to find slot of labelphase in hashtable, returns empty slot if not found */
+
+static StaStatNode ** findSlot(StaStatTable *ptable, char* label, char* phase) {
+
+    unsigned mask = (unsigned) ptable->num_slots - 1;
+    unsigned islot;
+    StaStatNode **pslot;
+
+    for (islot = hash(label, phase) & mask; ; islot = (islot + 1) & mask) {
+        pslot = ptable->slot + islot;
+        if (*pslot == NULL
+                || (strcmp(label, (*pslot)->label) == 0 && strcmp(phase, (*pslot)->phase) == 0))
+            return (pslot);
+    }
+
+}
+
 /** function to lookup labelphase in hashtable */
 
 static StaStatNode * lookup(int ntable, char* label, char* phase) {
 
+    StaStatTable *ptable = sta_stat_table + ntable;
+
+    if (ptable->num_slots == 0)
+        return (NULL); /* not found */
+
+    return (*findSlot(ptable, label, phase));
+
+}
+
+/** function to get new node in hashtable, hashtable is enlarged if more than half full */
+
+static StaStatNode * newStaStatNode(StaStatTable *ptable, char* label, char* phase) {
+
+    int n, num_slots;
+    StaStatNode **slot, **slot_old, **block;
     StaStatNode *np;
 
-    for (np = hashtab[ntable][hash(label, phase)]; np != NULL; np = np->next)
-        if (strcmp(label, np->label) == 0
-                && strcmp(phase, np->phase) == 0)
-            return (np); /* found */
+    if (2 * (ptable->num_nodes + 1) > ptable->num_slots) {
+        num_slots = ptable->num_slots > 0 ? 2 * ptable->num_slots : 1024;
+        if ((slot = (StaStatNode **) calloc(num_slots, sizeof (StaStatNode *))) == NULL)
+            return (NULL);
+        slot_old = ptable->slot;
+        ptable->slot = slot;
+        ptable->num_slots = num_slots;
+        for (n = 0; n < ptable->num_nodes; n++) {
+            np = ptable->block[n / STA_STAT_BLOCK_SIZE] + n % STA_STAT_BLOCK_SIZE;
+            *findSlot(ptable, np->label, np->phase) = np;
+        }
+        free(slot_old);
+    }
 
-    return (NULL); /* not found */
+    if (ptable->num_nodes == ptable->num_blocks * STA_STAT_BLOCK_SIZE) {
+        if ((block = (StaStatNode **) realloc(ptable->block, (ptable->num_blocks + 1) * sizeof (StaStatNode *))) == NULL)
+            return (NULL);
+        ptable->block = block;
+        if ((ptable->block[ptable->num_blocks] = (StaStatNode *) malloc(STA_STAT_BLOCK_SIZE * sizeof (StaStatNode))) == NULL)
+            return (NULL);
+        ptable->num_blocks++;
+    }
+
+    np = ptable->block[ptable->num_nodes / STA_STAT_BLOCK_SIZE] + ptable->num_nodes % STA_STAT_BLOCK_SIZE;
+    ptable->num_nodes++;
+    strcpy(np->label, label);
+    strcpy(np->phase, phase);
+    *findSlot(ptable, label, phase) = np;
+
+    return (np);
 
 }
 
@@ -13264,16 +14230,12 @@ static StaStatNode * lookup(int ntable, char* label, char* phase) {
 StaStatNode * InstallStaStatInTable(int ntable, char* label, char* phase, int flag_ignore,
         double residual, double weight,
         double pdf_residual_sum, double pdf_weight_sum, double delay) {
-    int icomp;
-    StaStatNode *np, *npcheck, *nplast;
-    unsigned hashval;
+    StaStatNode *np;
 
     if ((np = lookup(ntable, label, phase)) == NULL) {
         /* not found, create new StaStatNode */
-        if ((np = (StaStatNode *) malloc(sizeof (StaStatNode))) == NULL)
+        if ((np = newStaStatNode(sta_stat_table + ntable, label, phase)) == NULL)
             return (NULL);
-        strcpy(np->label, label);
-        strcpy(np->phase, phase);
         np->flag_ignore = flag_ignore;
         np->residual_min = residual;
         np->residual_max = residual;
@@ -13281,9 +14243,6 @@ StaStatNode * InstallStaStatInTable(int ntable, char* label, char* phase, int fl
         np->residual_square_sum = residual * residual * weight;
         np->weight_sum = weight;
         np->num_residuals = 1;
-        np->next = NULL; // 20101124 racine@sed.ethz.ch - added: Otherwise the next pointer will be left uninitialized under some circumstances
-        // which leads to a crash when FreeStaStatTable() is called and the pointer is non-zero.
-        // After this fix, it seems that this solves the memory problems.
         if (pdf_weight_sum > VERY_SMALL_DOUBLE) {
             np->pdf_residual_sum =
                     pdf_residual_sum / pdf_weight_sum;
@@ -13294,23 +14253,6 @@ StaStatNode * InstallStaStatInTable(int ntable, char* label, char* phase, int fl
             np->num_pdf_residuals = 0;
         }
         np->delay = delay;
-
-        /* put in table in alphabetical order */
-        hashval = hash(label, phase);
-        nplast = NULL;
-        npcheck = hashtab[ntable][hashval];
-        while (npcheck != NULL &&
-                (icomp = strcmp(npcheck->label, label)) <= 0) {
-            if (icomp == 0 && strcmp(npcheck->phase, phase) >= 0)
-                break;
-            nplast = npcheck;
-            npcheck = npcheck->next;
-        }
-        np->next = npcheck;
-        if (nplast != NULL)
-            nplast->next = np;
-        else
-            hashtab[ntable][hashval] = np;
     } else {
         /* already there */
         if (residual < np->residual_min)
@@ -13338,23 +14280,16 @@ StaStatNode * InstallStaStatInTable(int ntable, char* label, char* phase, int fl
 /** function to free hashtable */
 
 int FreeStaStatTable(int ntable) {
-    int nnodes;
-    unsigned hashval;
-    StaStatNode *np, *np_curr;
-
+    int nnodes, nblock;
+    StaStatTable *ptable = sta_stat_table + ntable;
 
-    nnodes = 0;
-    for (hashval = 0; hashval < HASHSIZE; hashval++) {
-        for (np = hashtab[ntable][hashval]; np != NULL;) {
 
-            np_curr = np;
-            np = np->next;
-            free(np_curr);
-            np_curr = NULL;
-            nnodes++;
-        }
-        hashtab[ntable][hashval] = NULL; // 20101129 AJL Bug fix.
-    }
+    nnodes = ptable->num_nodes;
+    for (nblock = 0; nblock < ptable->num_blocks; nblock++)
+        free(ptable->block[nblock]);
+    free(ptable->block);
+    free(ptable->slot);
+    memset(ptable, 0, sizeof (StaStatTable));
 
     return (nnodes);
 
@@ -13367,11 +14302,11 @@ int WriteStaStatTable(int ntable, FILE *fpio,
         double p_residual_max, double s_residual_max,
         double ell_len3_max, double hypo_depth_min, double hypo_depth_max,
         double hypo_dist_max, int imode) {
-    int nnodes;
-    unsigned hashval;
+    int nnodes, n;
     char frmt1[MAXLINE], frmt2[MAXLINE];
     double res_temp, res_std_temp;
-    StaStatNode *np;
+    StaStatNode *np, **nodes;
+    StaStatTable *ptable = sta_stat_table + ntable;
 
     /* 20160919 AJL  sprintf(frmt1, "LOCDELAY  %%-%ds %%-%ds %%-8d %%-12lf %%-12lf\n",
             ARRIVAL_LABEL_LEN, ARRIVAL_LABEL_LEN);
@@ -13414,52 +14349,61 @@ int WriteStaStatTable(int ntable, FILE *fpio,
                 "#         ID      Phase   Nres      TotCorr      StdDev\n");
     }
 
+    /* sort nodes by first char of label, label and phase */
+    if ((nodes = (StaStatNode **) malloc((ptable->num_nodes + 1) * sizeof (StaStatNode *))) == NULL) {
+        nll_puterr("ERROR: allocating memory for station statistics output.");
+        return (-1);
+    }
+    for (n = 0; n < ptable->num_nodes; n++)
+        nodes[n] = ptable->block[n / STA_STAT_BLOCK_SIZE] + n % STA_STAT_BLOCK_SIZE;
+    qsort(nodes, ptable->num_nodes, sizeof (StaStatNode *), compareStaStatNodes);
+
     nnodes = 0;
-    for (hashval = 0; hashval < HASHSIZE; hashval++) {
-        for (np = hashtab[ntable][hashval]; np != NULL; np = np->next) {
-            if (imode == WRITE_RESIDUALS || imode == WRITE_RES_DELAYS) {
-                res_temp = np->residual_sum / np->weight_sum;
-                res_std_temp = np->residual_square_sum / np->weight_sum - res_temp * res_temp;
-                if (np->num_residuals > 1)
-                    res_std_temp = sqrt(np->residual_square_sum / np->weight_sum - res_temp * res_temp);
-                else
-                    res_std_temp = -1.0;
-                if (imode == WRITE_RESIDUALS) {
-                    fprintf(fpio, frmt2, np->label, np->phase,
-                            np->num_residuals, res_temp, res_std_temp,
-                            np->residual_min, np->residual_max, np->flag_ignore);
-                } else if (imode == WRITE_RES_DELAYS) {
-                    fprintf(fpio, frmt1, np->label, np->phase,
-                            np->num_residuals, res_temp + np->delay, res_std_temp);
-                }
-                //printf("LOCDELAY  %s %s %d %f = %f + %f/%f\n", np->label, np->phase, np->num_residuals, res_temp,
-                //np->delay, np->residual_sum, np->weight_sum);
-            } else if (imode == WRITE_PDF_RESIDUALS || imode == WRITE_PDF_DELAYS) {
-                if (np->num_pdf_residuals > 0) {
-                    res_temp = np->pdf_residual_sum / (double) np->num_pdf_residuals;
-                } else {
-                    res_temp = 0.0;
-                }
-                if (np->num_pdf_residuals > 1)
-                    res_std_temp = sqrt(np->pdf_residual_square_sum
-                        / (double) (np->num_pdf_residuals - 1)
-                        - res_temp * res_temp);
-                else
-                    res_std_temp = -1.0;
-                if (imode == WRITE_PDF_RESIDUALS) {
-                    fprintf(fpio, frmt2, np->label, np->phase,
-                            np->num_pdf_residuals, res_temp, res_std_temp,
-                            np->residual_min, np->residual_max, np->flag_ignore);
-                } else if (imode == WRITE_PDF_DELAYS) {
-
-                    fprintf(fpio, frmt1, np->label, np->phase,
-                            np->num_pdf_residuals, res_temp + np->delay, res_std_temp);
-                }
+    for (n = 0; n < ptable->num_nodes; n++) {
+        np = nodes[n];
+        if (imode == WRITE_RESIDUALS || imode == WRITE_RES_DELAYS) {
+            res_temp = np->residual_sum / np->weight_sum;
+            res_std_temp = np->residual_square_sum / np->weight_sum - res_temp * res_temp;
+            if (np->num_residuals > 1)
+                res_std_temp = sqrt(np->residual_square_sum / np->weight_sum - res_temp * res_temp);
+            else
+                res_std_temp = -1.0;
+            if (imode == WRITE_RESIDUALS) {
+                fprintf(fpio, frmt2, np->label, np->phase,
+                        np->num_residuals, res_temp, res_std_temp,
+                        np->residual_min, np->residual_max, np->flag_ignore);
+            } else if (imode == WRITE_RES_DELAYS) {
+                fprintf(fpio, frmt1, np->label, np->phase,
+                        np->num_residuals, res_temp + np->delay, res_std_temp);
+            }
+            //printf("LOCDELAY  %s %s %d %f = %f + %f/%f\n", np->label, np->phase, np->num_residuals, res_temp,
+            //np->delay, np->residual_sum, np->weight_sum);
+        } else if (imode == WRITE_PDF_RESIDUALS || imode == WRITE_PDF_DELAYS) {
+            if (np->num_pdf_residuals > 0) {
+                res_temp = np->pdf_residual_sum / (double) np->num_pdf_residuals;
+            } else {
+                res_temp = 0.0;
+            }
+            if (np->num_pdf_residuals > 1)
+                res_std_temp = sqrt(np->pdf_residual_square_sum
+                    / (double) (np->num_pdf_residuals - 1)
+                    - res_temp * res_temp);
+            else
+                res_std_temp = -1.0;
+            if (imode == WRITE_PDF_RESIDUALS) {
+                fprintf(fpio, frmt2, np->label, np->phase,
+                        np->num_pdf_residuals, res_temp, res_std_temp,
+                        np->residual_min, np->residual_max, np->flag_ignore);
+            } else if (imode == WRITE_PDF_DELAYS) {
+
+                fprintf(fpio, frmt1, np->label, np->phase,
+                        np->num_pdf_residuals, res_temp + np->delay, res_std_temp);
             }
-            nnodes++;
         }
+        nnodes++;
     }
 
+    free(nodes);
 
     return (nnodes);
 
@@ -13579,6 +14523,15 @@ int setStationDistributionWeights(SourceDesc *stations, int numStations, Arrival
 
 }
 
+/** function to check if travel time of an arrival is read with ReadAbsInterpGrid3dBatch() in getTravelTimes() */
+
+static int isBatchTravelTime(ArrivalDesc *parrival) {
+
+    return (parrival->n_companion < 0 && parrival->gdesc.type == GRID_TIME
+            && parrival->gdesc.buffer != NULL && !isCascadingGrid(&(parrival->gdesc))
+            && !isQuantisedGrid(&(parrival->gdesc)));
+}
+
 /** function to get travel times for all observed arrivals */
 
 int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yval, double zval) {
@@ -13631,6 +14584,45 @@ int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yv
         }*/
     }
 
+    /* read travel times from 3D grids in memory, interpolated together for grids with identical geometry */
+
+    GridDesc* batch_grid[GRID_INTERP_BATCH_SIZE];
+    GRID_FLOAT_TYPE batch_value[GRID_INTERP_BATCH_SIZE];
+    int batch_narr[GRID_INTERP_BATCH_SIZE];
+    int nbatch = 0;
+    for (narr = 0; narr < num_arr_loc; narr++) {
+        if (isBatchTravelTime(arrival + narr)) {
+            batch_narr[nbatch] = narr;
+            batch_grid[nbatch++] = &(arrival[narr].gdesc);
+        }
+        if (nbatch == GRID_INTERP_BATCH_SIZE || (nbatch > 0 && narr == num_arr_loc - 1)) {
+            ReadAbsInterpGrid3dBatch(batch_grid, nbatch, xval, yval, zval, batch_value);
+            for (int n = 0; n < nbatch; n++)
+                arrival[batch_narr[n]].pred_travel_time = (double) batch_value[n];
+            nbatch = 0;
+        }
+    }
+
+    /* epicentral distances for 2D grids (1D model), calculated together for all stations */
+
+    double batch_xsta[GRID_INTERP_BATCH_SIZE];
+    double batch_ysta[GRID_INTERP_BATCH_SIZE];
+    double batch_dist[GRID_INTERP_BATCH_SIZE];
+    nbatch = 0;
+    for (narr = 0; narr < num_arr_loc; narr++) {
+        if (arrival[narr].n_companion < 0 && arrival[narr].gdesc.type != GRID_TIME) {
+            batch_narr[nbatch] = narr;
+            batch_xsta[nbatch] = arrival[narr].station.x;
+            batch_ysta[nbatch++] = arrival[narr].station.y;
+        }
+        if (nbatch == GRID_INTERP_BATCH_SIZE || (nbatch > 0 && narr == num_arr_loc - 1)) {
+            GetEpiDistArray(xval, yval, batch_xsta, batch_ysta, batch_dist, nbatch);
+            for (int n = 0; n < nbatch; n++)
+                arrival[batch_narr[n]].pred_epi_dist = GeometryMode == MODE_GLOBAL ? batch_dist[n] * KM2DEG : batch_dist[n];
+            nbatch = 0;
+        }
+    }
+
     /* loop over observed arrivals */
 
     nReject = 0;
@@ -13642,7 +14634,11 @@ int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yv
             arrival[narr].pred_travel_time *= arrival[narr].tfact;
             /* else check grid type */
         } else {
-            if (arrival[narr].gdesc.type == GRID_TIME) {
+            if (isBatchTravelTime(arrival + narr)) {
+                /* 3D grid in memory, travel time already read above */
+                if (arrival[narr].pred_travel_time < 0.0)
+                    nReject++;
+            } else if (arrival[narr].gdesc.type == GRID_TIME) {
                 /* 3D grid */
                 if (arrival[narr].gdesc.buffer == NULL) {
                     /* read time grid from disk */
@@ -13655,10 +14651,8 @@ int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yv
                         xval, yval, zval, 0)) < 0.0)
                     nReject++;
             } else {
-                /* 2D grid (1D model) */
-                yval_grid = GetEpiDist(&(arrival[narr].station), xval, yval);
-                if (GeometryMode == MODE_GLOBAL)
-                    yval_grid *= KM2DEG;
+                /* 2D grid (1D model), epicentral distance calculated above */
+                yval_grid = arrival[narr].pred_epi_dist;
                 if (arrival[narr].sheetdesc.buffer == NULL) {
                     /* read time grid from disk */
                     fp_grid = arrival[narr].fpgrid;
@@ -13704,32 +14698,47 @@ int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yv
 
 
 
-/** function to apply crustal correction and elevation correction */
+/** function to set up crustal correction and elevation correction for arrivals,
+ *  the station correction does not depend on the hypocenter and is evaluated once per location */
 
 // assumes vertical ray (dtdd = 0.0) !!!
 
-double applyCrustElevCorrection(ArrivalDesc* parrival, double xval, double yval, double zval) {
+void initCrustElevCorrection(ArrivalDesc* arrival, int num_arrivals) {
 
-    double correction = 0.0;
+    int narr;
     double dtdd = 0.0;
-    char cphase;
+    ArrivalDesc* parrival;
 
-    if (IsPhaseID(parrival->phase, "P"))
-        cphase = 'P';
-    else if (IsPhaseID(parrival->phase, "S"))
-        cphase = 'S';
-    else
-        return (0.0);
+    init_crust_corr_table();
 
+    for (narr = 0; narr < num_arrivals; narr++) {
+        parrival = arrival + narr;
+        if (IsPhaseID(parrival->phase, "P"))
+            parrival->crust_corr_phase = 'P';
+        else if (IsPhaseID(parrival->phase, "S"))
+            parrival->crust_corr_phase = 'S';
+        else
+            parrival->crust_corr_phase = '\0';
+        parrival->crust_corr_station = 0.0;
+        if (parrival->crust_corr_phase != '\0')
+            parrival->crust_corr_station =
+                calc_crust_corr(parrival->crust_corr_phase, parrival->station.dlat,
+                parrival->station.dlong, 0.0, -1000.0 * parrival->station.depth, dtdd);
+    }
+
+}
 
-    // source
-    correction = calc_crust_corr(cphase, yval, xval, zval, VERY_LARGE_DOUBLE, dtdd);
-    // receiver
-    correction +=
-            calc_crust_corr(cphase, parrival->station.dlat,
-            parrival->station.dlong, 0.0, -1000.0 * parrival->station.depth, dtdd);
+/** function to apply crustal correction and elevation correction, initCrustElevCorrection() must be called first */
 
-    return (correction);
+// assumes vertical ray (dtdd = 0.0) !!!
+
+double applyCrustElevCorrection(ArrivalDesc* parrival, double xval, double yval, double zval) {
+
+    if (parrival->crust_corr_phase == '\0')
+        return (0.0);
+
+    // source + receiver
+    return (calc_crust_corr_source(parrival->crust_corr_phase, yval, xval, zval) + parrival->crust_corr_station);
 
 }
 
@@ -13813,6 +14822,261 @@ Tree3D * InitializeOcttree(GridDesc* ptgrid, OcttreeParams * pParams) {
     return (newTree);
 }
 
+/** Octree cell evaluation, optionally distributed over NumSearchThreads threads
+ *
+ *  Cells are evaluated in batches, results are added to the result tree by the calling thread
+ *  in the same order as for sequential evaluation, so results do not depend on the number of threads.
+ */
+
+#define OCT_EVAL_BATCH_MAX 1024
+
+typedef struct {
+    OctNode* pnode;
+    long double value;
+    double misfit;
+    double log_value_volume;
+    double volume;
+    double volume_min;
+    double diagonal;
+    double cell_half_diagonal_time_range;
+}
+OctCellEval;
+
+typedef struct OctEvalPool OctEvalPool;
+
+typedef struct {
+    OctEvalPool* pool;
+    int ithread;
+    ArrivalDesc* arrival; // private copy of arrivals
+    GaussLocParams gauss_par; // private copy of gauss params with own EDT matrix and EDT arrival data
+    EdtArrivalData edt_data; // private EDT arrival data work arrays
+    pthread_t thread;
+}
+OctEvalWorker;
+
+struct OctEvalPool {
+    // evaluation parameters common to all cells
+    int ngrid;
+    int num_arr_loc;
+    ArrivalDesc* arrival;
+    GaussLocParams* gauss_par;
+    OcttreeParams* pParams;
+    int icalc_cell_diagonal_time_var;
+    int iGridType;
+    double logWtMtrxSum;
+    // current batch
+    OctCellEval cells[OCT_EVAL_BATCH_MAX];
+    int ncells;
+    double* pred_travel_time; // predicted travel times for each cell in batch (ncells x num_arr_loc)
+    // threads, calling thread has index 0
+    int nthreads;
+    OctEvalWorker* workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_start;
+    pthread_cond_t cond_done;
+    int generation;
+    int npending;
+    int shutdown;
+};
+
+/** function to check if cells can be evaluated concurrently, i.e. do not use shared state other than read-only data */
+
+static int OctEvalPool_isThreadSafe(int num_arr_loc, ArrivalDesc *arrival, OcttreeParams* pParams) {
+
+    if (pParams->use_stations_density > 0)
+        return (0);
+
+    return (isConcurrentEvalSafe(num_arr_loc, arrival));
+
+}
+
+/** function to evaluate the share of cells of current batch for one thread */
+
+static void OctEvalPool_evalCells(OctEvalPool* pool, int ithread, ArrivalDesc *arrival, GaussLocParams* gauss_par) {
+
+    int n, n0, n1, narr;
+    OctCellEval* pcell;
+    double* pred_travel_time;
+
+    n0 = (pool->ncells * ithread) / pool->nthreads;
+    n1 = (pool->ncells * (ithread + 1)) / pool->nthreads;
+
+    for (n = n0; n < n1; n++) {
+        pcell = pool->cells + n;
+        // cell values not calculated by LocOctree_eval keep these initial values
+        pcell->volume_min = VERY_LARGE_DOUBLE;
+        pcell->diagonal = 0.0;
+        pcell->cell_half_diagonal_time_range = 0.0;
+        pcell->value = LocOctree_eval(pool->ngrid, pcell->pnode->center.x, pcell->pnode->center.y, pcell->pnode->center.z,
+                pool->num_arr_loc, arrival, pcell->pnode,
+                pool->icalc_cell_diagonal_time_var, &pcell->volume_min, &pcell->diagonal,
+                &pcell->cell_half_diagonal_time_range, pool->pParams, gauss_par, pool->iGridType, &pcell->misfit,
+                pool->logWtMtrxSum, &pcell->log_value_volume, &pcell->volume);
+        pred_travel_time = pool->pred_travel_time + n * pool->num_arr_loc;
+        for (narr = 0; narr < pool->num_arr_loc; narr++)
+            pred_travel_time[narr] = arrival[narr].pred_travel_time;
+    }
+
+}
+
+static void* OctEvalPool_run(void* arg) {
+
+    OctEvalWorker* worker = (OctEvalWorker*) arg;
+    OctEvalPool* pool = worker->pool;
+    int generation = 0;
+
+    while (1) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->generation == generation && !pool->shutdown)
+            pthread_cond_wait(&pool->cond_start, &pool->mutex);
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        OctEvalPool_evalCells(pool, worker->ithread, worker->arrival, &worker->gauss_par);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->npending == 0)
+            pthread_cond_signal(&pool->cond_done);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return (NULL);
+
+}
+
+/** function to create pool for Octree cell evaluation, returns NULL on error */
+
+static OctEvalPool* OctEvalPool_create(int ngrid, int num_arr_loc, ArrivalDesc *arrival, GaussLocParams* gauss_par,
+        OcttreeParams* pParams, int icalc_cell_diagonal_time_var, int iGridType, double logWtMtrxSum, int nthreads) {
+
+    int n, nrow;
+    OctEvalPool* pool;
+    OctEvalWorker* worker;
+
+    if ((pool = (OctEvalPool*) calloc(1, sizeof (OctEvalPool))) == NULL)
+        return (NULL);
+    pool->ngrid = ngrid;
+    pool->num_arr_loc = num_arr_loc;
+    pool->arrival = arrival;
+    pool->gauss_par = gauss_par;
+    pool->pParams = pParams;
+    pool->icalc_cell_diagonal_time_var = icalc_cell_diagonal_time_var;
+    pool->iGridType = iGridType;
+    pool->logWtMtrxSum = logWtMtrxSum;
+    pool->nthreads = 1;
+    if ((pool->pred_travel_time = (double*) malloc(OCT_EVAL_BATCH_MAX * (num_arr_loc > 0 ? num_arr_loc : 1) * sizeof (double))) == NULL) {
+        free(pool);
+        return (NULL);
+    }
+
+    if (nthreads <= 1)
+        return (pool);
+
+    if ((pool->workers = (OctEvalWorker*) calloc(nthreads, sizeof (OctEvalWorker))) == NULL)
+        return (pool);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond_start, NULL);
+    pthread_cond_init(&pool->cond_done, NULL);
+
+    for (n = 1; n < nthreads; n++) {
+        worker = pool->workers + n;
+        worker->pool = pool;
+        worker->ithread = n;
+        worker->gauss_par = *gauss_par;
+        if ((worker->arrival = (ArrivalDesc*) malloc(num_arr_loc * sizeof (ArrivalDesc))) == NULL)
+            break;
+        memcpy(worker->arrival, arrival, num_arr_loc * sizeof (ArrivalDesc));
+        // EDT matrix diagonal is modified during evaluation (Gauss2)
+        if (gauss_par->EDTMtrx != NULL) {
+            if ((worker->gauss_par.EDTMtrx = matrix_double(num_arr_loc, num_arr_loc)) == NULL) {
+                free(worker->arrival);
+                break;
+            }
+            for (nrow = 0; nrow < num_arr_loc; nrow++)
+                memcpy(worker->gauss_par.EDTMtrx[nrow], gauss_par->EDTMtrx[nrow], num_arr_loc * sizeof (double));
+        }
+        if (gauss_par->EDTData != NULL) {
+            if (AllocEdtArrivalData(&worker->edt_data, num_arr_loc) < 0) {
+                free_matrix_double(worker->gauss_par.EDTMtrx, num_arr_loc, num_arr_loc);
+                free(worker->arrival);
+                break;
+            }
+            worker->gauss_par.EDTData = &worker->edt_data;
+        }
+        if (pthread_create(&worker->thread, NULL, OctEvalPool_run, worker) != 0) {
+            free_matrix_double(worker->gauss_par.EDTMtrx, num_arr_loc, num_arr_loc);
+            FreeEdtArrivalData(&worker->edt_data);
+            free(worker->arrival);
+            break;
+        }
+        pool->nthreads++;
+    }
+
+    return (pool);
+
+}
+
+/** function to evaluate all cells of current batch */
+
+static void OctEvalPool_evalBatch(OctEvalPool* pool) {
+
+    if (pool->ncells <= 0)
+        return;
+
+    if (pool->nthreads <= 1) {
+        OctEvalPool_evalCells(pool, 0, pool->arrival, pool->gauss_par);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->npending = pool->nthreads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->cond_start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    OctEvalPool_evalCells(pool, 0, pool->arrival, pool->gauss_par);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->npending > 0)
+        pthread_cond_wait(&pool->cond_done, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+
+}
+
+static void OctEvalPool_free(OctEvalPool* pool) {
+
+    int n;
+    OctEvalWorker* worker;
+
+    if (pool == NULL)
+        return;
+
+    if (pool->workers != NULL) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->shutdown = 1;
+        pthread_cond_broadcast(&pool->cond_start);
+        pthread_mutex_unlock(&pool->mutex);
+        for (n = 1; n < pool->nthreads; n++) {
+            worker = pool->workers + n;
+            pthread_join(worker->thread, NULL);
+            free_matrix_double(worker->gauss_par.EDTMtrx, pool->num_arr_loc, pool->num_arr_loc);
+            FreeEdtArrivalData(&worker->edt_data);
+            free(worker->arrival);
+        }
+        pthread_mutex_destroy(&pool->mutex);
+        pthread_cond_destroy(&pool->cond_start);
+        pthread_cond_destroy(&pool->cond_done);
+        free(pool->workers);
+    }
+    free(pool->pred_travel_time);
+    free(pool);
+
+}
+
 /** function to perform Octree location */
 
 int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
@@ -13863,6 +15127,10 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
 
     //double stationDensityWeight = 0.0;
 
+    int ncell, nthreads;
+    OctCellEval* pcell;
+    OctEvalPool* pool;
+
 
 
     // reset EDT_otime_weight_active flag
@@ -13893,36 +15161,61 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
     if (GeometryMode == MODE_GLOBAL)
         min_node_size_x = min_node_size_y = pParams->min_node_size * KM2DEG;
 
+    // set up results tree node pool, blocks allocated for previous grids of this location are re-used
+    if (resultTreeNodePool == NULL)
+        resultTreeNodePool = newNodePool(sizeof (ResultTreeNode), NODE_POOL_BLOCK_SIZE);
+    if (resultTreeNodePool == NULL) {
+        nll_puterr("ERROR: allocating Octree result tree node pool.");
+        return (-1);
+    }
+    resetNodePool(resultTreeNodePool);
+
+    // set up cell evaluation, concurrent only if all data used is read-only
+    nthreads = NumSearchThreads;
+    if (nthreads > 1 && !OctEvalPool_isThreadSafe(num_arr_loc, arrival, pParams)) {
+        nll_putmsg(2, "INFO: Octree search method or travel time grids do not support concurrent evaluation, using 1 thread.");
+        nthreads = 1;
+    }
+    pool = OctEvalPool_create(ngrid, num_arr_loc, arrival, gauss_par, pParams,
+            icalc_cell_diagonal_time_var, iGridType, logWtMtrxSum, nthreads);
+    if (pool == NULL) {
+        nll_puterr("ERROR: allocating Octree cell evaluation pool.");
+        return (-1);
+    }
+
     /* first get solutions at each cell in Tree3D */
 
     nSamples = 0;
     resultTreeRoot = NULL;
+    pool->ncells = 0;
     for (ix = 0; ix < pOctTree->numx; ix++) {
         for (iy = 0; iy < pOctTree->numy; iy++) {
             for (iz = 0; iz < pOctTree->numz; iz++) {
                 poct_node = pOctTree->nodeArray[ix][iy][iz];
-                if (poct_node == NULL) // case of Tree3D_spherical
+                if (poct_node != NULL) { // NULL in case of Tree3D_spherical
+                    pool->cells[pool->ncells++].pnode = poct_node;
+                    // save node size
+                    smallest_node_size_x = poct_node->ds.x;
+                    smallest_node_size_y = poct_node->ds.y;
+                    smallest_node_size_z = poct_node->ds.z;
+                }
+                if (pool->ncells < OCT_EVAL_BATCH_MAX
+                        && !(ix == pOctTree->numx - 1 && iy == pOctTree->numy - 1 && iz == pOctTree->numz - 1))
                     continue;
-                // $$$ NOTE: this block must be identical to block $$$ below
-                xval = poct_node->center.x;
-                yval = poct_node->center.y;
-                zval = poct_node->center.z;
-                value = LocOctree_core(ngrid, xval, yval, zval, num_arr_loc, arrival, poct_node,
-                        icalc_cell_diagonal_time_var, &volume_min, &diagonal,
-                        &cell_half_diagonal_time_range, pParams, gauss_par, iGridType, &misfit, logWtMtrxSum);
-                nSamples++;
-                // END - this block must be identical to block $$$ below
-
-                // save node size
-                smallest_node_size_x = poct_node->ds.x;
-                smallest_node_size_y = poct_node->ds.y;
-                smallest_node_size_z = poct_node->ds.z;
-
-                if (message_flag >= 1 && nSamples % 5000 == 0) {
-                    fprintf(stdout,
-                            "OctTree num samples = %d / %d\r", nSamples, pParams->max_num_nodes);
-                    fflush(stdout);
+
+                OctEvalPool_evalBatch(pool);
+                for (ncell = 0; ncell < pool->ncells; ncell++) {
+                    pcell = pool->cells + ncell;
+                    resultTreeRoot = addResult(resultTreeNodePool, resultTreeRoot, pcell->log_value_volume, pcell->volume, pcell->pnode);
+                    nSamples++;
+
+                    if (message_flag >= 1 && nSamples % 5000 == 0) {
+                        fprintf(stdout,
+                                "OctTree num samples = %d / %d\r", nSamples, pParams->max_num_nodes);
+                        fflush(stdout);
+                    }
                 }
+                pool->ncells = 0;
 
             }
         }
@@ -13963,6 +15256,7 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
         int n_neigh_max = 7;
         if (LocMethod == METH_OT_STACK) // this is in warning monitor for speed and efficiency in convergence, with the risk of less thorough search
             n_neigh_max = 1;
+        pool->ncells = 0;
         for (n_neigh = 0; n_neigh < n_neigh_max; n_neigh++) {
 
             if (n_neigh == 0) {
@@ -14009,8 +15303,8 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
             }
 
 
-            // subdivide node and evaluate solution at each child
-            subdivide(neighbor_node, OCTREE_UNDEF_VALUE, NULL);
+            // subdivide node, solution at each child is evaluated below
+            subdivide(pOctTree->nodePool, neighbor_node, OCTREE_UNDEF_VALUE, NULL);
 
             for (ix = 0; ix < 2; ix++) {
                 for (iy = 0; iy < 2; iy++) {
@@ -14029,79 +15323,91 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
                         if (poct_node->ds.z < smallest_node_size_z)
                             smallest_node_size_z = poct_node->ds.z;
 
-                        // $$$ NOTE: this block must be identical to block $$$ above
-                        xval = poct_node->center.x;
-                        yval = poct_node->center.y;
-                        zval = poct_node->center.z;
-                        value = LocOctree_core(ngrid, xval, yval, zval, num_arr_loc, arrival, poct_node,
-                                icalc_cell_diagonal_time_var, &volume_min, &diagonal,
-                                &cell_half_diagonal_time_range, pParams, gauss_par, iGridType, &misfit, logWtMtrxSum);
-                        nSamples++;
-                        // END - this block must be identical to block $$$ above
-
-                        if (message_flag >= 1 && nSamples % 5000 == 0) {
-                            fprintf(stdout,
-                                    "OctTree num samples = %d / %d\r", nSamples, pParams->max_num_nodes);
-                            fflush(stdout);
-                        }
-
-                        // check value
-                        /*if (value < -LARGE_FLOAT) {
-                            sprintf(MsgStr, "ERROR: log(prob_density) at (%lf,%lf,%lf) is too small %lg.", xval, yval, zval, (double) value);
-                            nll_puterr(MsgStr);
-                        }*/
-                        /*if (isnan(value)) {
-                            sprintf(MsgStr, "WARNNG: log(prob_density) at (%lf,%lf,%lf) is NaN (%lg), reset to %g.", xval, yval, zval, (double) value, -VERY_LARGE_DOUBLE);
-                            nll_puterr(MsgStr);
-                            value = -VERY_LARGE_DOUBLE;
-                        }*/
-
-                        /* check for maximum likelihood */
-                        //printf("value=%lg, value_max=%lg, diagonal=%f\r", (double) value, (double) value_max, diagonal);
-                        if (value >= value_max) {
-                            //printf(">>>>>>>>>>>>>>>>> value=%lg > value_max=%lg!!, diagonal=%f, xyz= %f %g %g\n", (double) value, (double) value_max, diagonal, xval, yval, zval);
-                            value_max = value;
-                            misfit_min = misfit;
-                            phypo->misfit = misfit;
-                            phypo->x = xval;
-                            phypo->y = yval;
-                            phypo->z = zval;
-                            hypo_dx = poct_node->ds.x;
-                            hypo_dz = poct_node->ds.z;
-                            for (narr = 0; narr < num_arr_loc; narr++)
-                                arrival[narr].pred_travel_time_best = arrival[narr].pred_travel_time;
-                            poct_node_best = poct_node;
-                            *poct_node_value_max = poct_node->value;
-                            cell_diagonal_time_var_best = cell_half_diagonal_time_range * cell_half_diagonal_time_range;
-                            cell_diagonal_best = diagonal;
-                            cell_volume_best = volume_min;
-                        }
-                        if (misfit > 0.0 && misfit > misfit_max) // misfit < 0 for topo masking
-                            misfit_max = misfit;
+                        pool->cells[pool->ncells++].pnode = poct_node;
 
+                    } // end triple loop over node children
+                }
+            }
 
-                        /* set to TRUE to save all samples, REMEMBER to set OCT num_scatter high enough in control file */
-                        if (0) {
-                            /* save sample to scatter file */
-                            fdata[ipos++] = xval;
-                            fdata[ipos++] = yval;
-                            fdata[ipos++] = zval;
-                            dlike = (long double) gauss_par->WtMtrxSum * (long double) exp(value);
-                            fdata[ipos++] = dlike;
+        } // end loop over HighestLeafValue neighbors
 
-                            /* update  probabilitic residuals */
-                            if (1)
-                                UpdateProbabilisticResiduals(num_arr_loc, arrival, 1.0);
+        // evaluate solution at each child of subdivided nodes
+        OctEvalPool_evalBatch(pool);
+
+        for (ncell = 0; ncell < pool->ncells; ncell++) {
+
+            pcell = pool->cells + ncell;
+            poct_node = pcell->pnode;
+            xval = poct_node->center.x;
+            yval = poct_node->center.y;
+            zval = poct_node->center.z;
+            value = pcell->value;
+            misfit = pcell->misfit;
+            volume_min = pcell->volume_min;
+            diagonal = pcell->diagonal;
+            cell_half_diagonal_time_range = pcell->cell_half_diagonal_time_range;
+            resultTreeRoot = addResult(resultTreeNodePool, resultTreeRoot, pcell->log_value_volume, pcell->volume, poct_node);
+            nSamples++;
+
+            if (message_flag >= 1 && nSamples % 5000 == 0) {
+                fprintf(stdout,
+                        "OctTree num samples = %d / %d\r", nSamples, pParams->max_num_nodes);
+                fflush(stdout);
+            }
+
+            // check value
+            /*if (value < -LARGE_FLOAT) {
+                sprintf(MsgStr, "ERROR: log(prob_density) at (%lf,%lf,%lf) is too small %lg.", xval, yval, zval, (double) value);
+                nll_puterr(MsgStr);
+            }*/
+            /*if (isnan(value)) {
+                sprintf(MsgStr, "WARNNG: log(prob_density) at (%lf,%lf,%lf) is NaN (%lg), reset to %g.", xval, yval, zval, (double) value, -VERY_LARGE_DOUBLE);
+                nll_puterr(MsgStr);
+                value = -VERY_LARGE_DOUBLE;
+            }*/
 
-                            nScatterSaved++;
-                        }
+            /* check for maximum likelihood */
+            //printf("value=%lg, value_max=%lg, diagonal=%f\r", (double) value, (double) value_max, diagonal);
+            if (value >= value_max) {
+                //printf(">>>>>>>>>>>>>>>>> value=%lg > value_max=%lg!!, diagonal=%f, xyz= %f %g %g\n", (double) value, (double) value_max, diagonal, xval, yval, zval);
+                value_max = value;
+                misfit_min = misfit;
+                phypo->misfit = misfit;
+                phypo->x = xval;
+                phypo->y = yval;
+                phypo->z = zval;
+                hypo_dx = poct_node->ds.x;
+                hypo_dz = poct_node->ds.z;
+                for (narr = 0; narr < num_arr_loc; narr++)
+                    arrival[narr].pred_travel_time_best = pool->pred_travel_time[ncell * num_arr_loc + narr];
+                poct_node_best = poct_node;
+                *poct_node_value_max = poct_node->value;
+                cell_diagonal_time_var_best = cell_half_diagonal_time_range * cell_half_diagonal_time_range;
+                cell_diagonal_best = diagonal;
+                cell_volume_best = volume_min;
+            }
+            if (misfit > 0.0 && misfit > misfit_max) // misfit < 0 for topo masking
+                misfit_max = misfit;
+
+
+            /* set to TRUE to save all samples, REMEMBER to set OCT num_scatter high enough in control file */
+            if (0) {
+                /* save sample to scatter file */
+                fdata[ipos++] = xval;
+                fdata[ipos++] = yval;
+                fdata[ipos++] = zval;
+                dlike = (long double) gauss_par->WtMtrxSum * (long double) exp(value);
+                fdata[ipos++] = dlike;
+                AddSampleStatistics(&scatter_statistics, (float) xval, (float) yval, (float) zval);
 
+                /* update  probabilitic residuals */
+                if (1)
+                    UpdateProbabilisticResiduals(num_arr_loc, arrival, 1.0);
 
-                    } // end triple loop over node children
-                }
+                nScatterSaved++;
             }
 
-        } // end loop over HighestLeafValue neighbors
+        } // end loop over evaluated cells
 
         // check if minimum node size reached
         if (pParams->stop_on_min_node_size && (smallest_node_size_x < min_node_size_x
@@ -14114,6 +15420,8 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
 
     } // end while (nSamples < pParams->max_num_nodes)
 
+    OctEvalPool_free(pool);
+
     if (message_flag >= 1)
         fprintf(stdout, "\n");
 
@@ -14201,6 +15509,33 @@ long double LocOctree_core(int ngrid, double xval, double yval, double zval,
         OcttreeParams* pParams, GaussLocParams* gauss_par, int iGridType,
         double *misfit, double logWtMtrxSum) {
 
+    long double value;
+    double volume, log_value_volume;
+
+    value = LocOctree_eval(ngrid, xval, yval, zval, num_arr_loc, arrival, poct_node,
+            icalc_cell_diagonal_time_var, volume_min, pdiagonal, cell_half_diagonal_time_range,
+            pParams, gauss_par, iGridType, misfit, logWtMtrxSum, &log_value_volume, &volume);
+
+    resultTreeRoot = addResult(resultTreeNodePool, resultTreeRoot, log_value_volume, volume, poct_node);
+
+    return (value);
+
+}
+
+/** function to evaluate solution in an Octree cell without adding it to the result tree
+ *
+ *  modifies only arrival, gauss_par and poct_node, may be called concurrently for different cells
+ *  with separate arrival and gauss_par (see LocOctree)
+ */
+
+long double LocOctree_eval(int ngrid, double xval, double yval, double zval,
+        int num_arr_loc, ArrivalDesc *arrival,
+        OctNode* poct_node,
+        int icalc_cell_diagonal_time_var, double *volume_min,
+        double *pdiagonal, double *cell_half_diagonal_time_range,
+        OcttreeParams* pParams, GaussLocParams* gauss_par, int iGridType,
+        double *misfit, double logWtMtrxSum, double *plog_value_volume, double *pvolume) {
+
     long double value;
 
     int iAboveTopo;
@@ -14292,7 +15627,8 @@ long double LocOctree_core(int ngrid, double xval, double yval, double zval,
     log_value_volume += logStationDensityWeight;
     poct_node->value += logStationDensityWeight;
 
-    resultTreeRoot = addResult(resultTreeRoot, log_value_volume, volume, poct_node);
+    *plog_value_volume = log_value_volume;
+    *pvolume = volume;
 
     /*static int icount_value = 0;
                                                                                                                                     if (icount_value < 10 && poct_node->value < -1.0e50) {
@@ -14589,6 +15925,11 @@ int GenEventScatterOcttree(OcttreeParams* pParams, double oct_node_value_max, fl
     tot_npoints = getScatterSampleResultTree(resultTreeRoot, VALUE_IS_LOG_PROB_DENSITY_IN_NODE, pParams->num_scatter, integral,
             fscatterdata, tot_npoints, &fdata_index, oct_node_value_max, &oct_tree_scatter_volume);
 
+    /* accumulate "traditional" statistics */
+    for (fdata_index = 0; fdata_index < 4 * tot_npoints; fdata_index += 4)
+        AddSampleStatistics(&scatter_statistics,
+            fscatterdata[fdata_index], fscatterdata[fdata_index + 1], fscatterdata[fdata_index + 2]);
+
     /* write message */
     if (message_flag >= 3) {
         sprintf(MsgStr, "  %d points generated, %d points requested, oct_tree_scatter_volume= %le",
@@ -51,6 +51,51 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 /*------------------------------------------------------------*/
 /* structures */
 
+/* EDT arrival pair index, pairs and their location independent weight factors, set once per location in ConstWeightMatrix() */
+
+typedef struct {
+    int num_arrivals; /* number of arrivals */
+    int *pair_start; /* pairs of row arrival n are pair_start[n] to pair_start[n + 1] - 1 (size num_arrivals + 1) */
+    int *pair_col; /* column arrival of pair, col > row */
+    double *pair_corr; /* correlation factor of pair: 1 - correlation coeff */
+    double *pair_sta_weight; /* station distribution weight factor of pair */
+    double *pair_prior_weight; /* prior weight factor of pair, 1 if not used */
+    double *pair_weight2; /* 1 / (sum of errors**2) of pair, if errors do not depend on travel times (no LOCGAU2), else NULL */
+    double *pair_weight; /* total weight of pair, if pair_weight2 != NULL, else NULL */
+}
+EdtPairIndex;
+
+/* structure-of-arrays arrival data for EDT pair loop, indexed by arrival, work arrays of CalcSolutionQuality_EDT()
+ *  set up in ConstWeightMatrix() for the calling thread and for each further thread of a concurrent search */
+
+typedef struct {
+    int size; /* allocated number of arrivals */
+    int *active; /* arrival has predicted time */
+    double *obs_centered;
+    double *pred_centered;
+    double *sigma2; /* EDT covariance matrix diagonal */
+    double *amplitude;
+}
+EdtArrivalData;
+
+/* hash index of arrivals on time grid label and on time grid file root, used to find duplicate and companion arrivals
+ *  without scanning all previous arrivals, arrivals 0 to num_indexed - 1 are in index, in increasing order in each chain */
+
+#define ARRIVAL_INDEX_HASHSIZE 2048
+
+typedef struct {
+    ArrivalDesc *arrival; /* indexed arrival array */
+    int num_indexed; /* number of arrivals in index */
+    int size_next; /* allocated size of next arrays */
+    int label_head[ARRIVAL_INDEX_HASHSIZE]; /* first arrival with time grid label hash value, -1 if none */
+    int label_tail[ARRIVAL_INDEX_HASHSIZE]; /* last arrival with time grid label hash value, -1 if none */
+    int *label_next; /* next arrival with same time grid label hash value, -1 if none */
+    int root_head[ARRIVAL_INDEX_HASHSIZE]; /* first arrival with time grid file root hash value, -1 if none */
+    int root_tail[ARRIVAL_INDEX_HASHSIZE]; /* last arrival with time grid file root hash value, -1 if none */
+    int *root_next; /* next arrival with same time grid file root hash value, -1 if none */
+}
+ArrivalIndex;
+
 /* gaussian errors location parameters */
 
 /*	see (TV82, eq. 10-14; MEN92, eq. 22) */
@@ -58,6 +103,8 @@ typedef struct {
     double SigmaT; /* theoretical error coeff for travel times */
     double CorrLen; /* model corellation length */
     MatrixDouble EDTMtrx; /* EDT covariance (row=col) or correlation (row!=col) matrix */
+    EdtPairIndex *EDTPairs; /* EDT arrival pair index */
+    EdtArrivalData *EDTData; /* EDT arrival data work arrays, private to each evaluating thread */
     MatrixDouble WtMtrx; /* weight matrix */
     double WtMtrxSum; /* sum of elements of weight matrix */
     long double meanObs; /* weighted mean of obs arrival times */
@@ -430,12 +477,18 @@ EXTERN_TXT double MetVelocity; /* velocity for conversion of distance to time */
 EXTERN_TXT double MetInititalTemperature; /* initial temperature */
 EXTERN_TXT int MetUse; /* number of samples to use
 					= MetNumSamples - MetEquil */
+/* number of independent Metropolis chains (<= 1 = single chain), set by caller, not reset by NLLoc() */
+EXTERN_TXT int MetNumChains;
 
 
 /* Octtree */
 EXTERN_TXT OcttreeParams octtreeParams; /* Octtree parameters */
+/* number of threads used by location search (<= 1 = sequential), set by caller, not reset by NLLoc() */
+EXTERN_TXT int NumSearchThreads;
 EXTERN_TXT Tree3D* octTree; /* Octtree */
 EXTERN_TXT ResultTreeNode* resultTreeRoot; /* Octtree likelihood*volume results tree root node */
+/* pool holding resultTreeRoot nodes, reset for each search grid, freed at the end of each location */
+EXTERN_TXT NodePool* resultTreeNodePool;
 //EXTERN_TXT ResultTreeNode* resultTreeLikelihoodRoot;	/* Octtree likelihood results tree root node */
 
 
@@ -458,9 +511,8 @@ EXTERN_TXT int NumOtimeLimit;
 
 /* from Kernigham and Ritchie, C prog lang, 2nd ed, 1988, sec 6.6 */
 
-struct staStatNode { /* station statistics node for linked list */
+struct staStatNode { /* station statistics node */
 
-    struct staStatNode *next; /* next entry in list */
     char label[ARRIVAL_LABEL_LEN]; /* arrival label (station name) */
     char phase[ARRIVAL_LABEL_LEN]; /* arrival phase id */
     int flag_ignore; /* ignore flag  = 1 if phase not used for misfit calc */
@@ -480,9 +532,16 @@ struct staStatNode { /* station statistics node for linked list */
 };
 typedef struct staStatNode StaStatNode;
 
-#define HASHSIZE 46
-/* table of pointers to list of StaStatNode */
-EXTERN_TXT StaStatNode *hashtab[MAX_NUM_LOCATION_GRIDS][HASHSIZE];
+#define STA_STAT_BLOCK_SIZE 256
+/* table of StaStatNode, open addressing hash on label and phase, nodes allocated in blocks */
+typedef struct {
+    StaStatNode **slot; /* hash table of pointers to nodes, NULL for empty slot */
+    int num_slots; /* number of slots, power of 2 */
+    int num_nodes; /* number of nodes in table */
+    StaStatNode **block; /* blocks of STA_STAT_BLOCK_SIZE nodes, node n is block[n / STA_STAT_BLOCK_SIZE][n % STA_STAT_BLOCK_SIZE] */
+    int num_blocks; /* number of allocated blocks */
+}
+StaStatTable;
 /* maxumum residual values to include in statistics */
 EXTERN_TXT int NRdgs_Min;
 EXTERN_TXT double RMS_Max, Gap_Max;
@@ -563,6 +622,7 @@ int LocGridSearch(int, int, int, ArrivalDesc*, GridDesc*,
         GaussLocParams*, HypoDesc*);
 int LocMetropolis(int, int, int, ArrivalDesc *,
         GridDesc*, GaussLocParams*, HypoDesc*, WalkParams*, float*);
+int MetNumSavedMax(void);
 int SaveBestLocation(OctNode* poct_node, int num_arr_total, int num_arr_loc, ArrivalDesc *arrival,
         GridDesc* ptgrid, GaussLocParams* gauss_par, HypoDesc* phypo,
         double misfit_max, int iGridType, int ignore_pred_travel_time_best,
@@ -630,6 +690,7 @@ double Calc_MD_FMAG(double coda_dur, double dist, double depth, double sta_corr,
 int setStationDistributionWeights(SourceDesc *stations, int numStations, ArrivalDesc *arrival, int nArrivals);
 
 int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yval, double zval);
+void initCrustElevCorrection(ArrivalDesc* arrival, int num_arrivals);
 double applyCrustElevCorrection(ArrivalDesc* parrival, double xval, double yval, double zval);
 int isAboveTopo(double xval, double yval, double zval);
 
@@ -646,6 +707,13 @@ long double LocOctree_core(int ngrid, double xval, double yval, double zval,
         double *diagonal, double *cell_diagonal_time_var,
         OcttreeParams* pParams, GaussLocParams* gauss_par, int iGridType,
         double *misfit, double logWtMtrxSum);
+long double LocOctree_eval(int ngrid, double xval, double yval, double zval,
+        int num_arr_loc, ArrivalDesc *arrival,
+        OctNode* poct_node,
+        int icalc_cell_diagonal_time_var, double *volume_min,
+        double *diagonal, double *cell_diagonal_time_var,
+        OcttreeParams* pParams, GaussLocParams* gauss_par, int iGridType,
+        double *misfit, double logWtMtrxSum, double *plog_value_volume, double *pvolume);
 double getOctTreeStationDensityWeight(OctNode* poct_node, SourceDesc *stations, int numStations, GridDesc *pgrid, int iOctLevelMax);
 int GenEventScatterOcttree(OcttreeParams* pParams, double oct_node_value_max, float* fscatterdata, double integral, HypoDesc* Hypocenter);
 
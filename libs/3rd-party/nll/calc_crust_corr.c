@@ -37,7 +37,21 @@
 
 /* Ignore water and ice layers for travel times but include in isostasy.	*/
 
+static double crust_corr (char ps, int c, double lat, double lon, double depth, double elev, double dtdd, int diagnostic );
+
 double calc_crust_corr (char ps, double lat, double lon, double depth, double elev, double dtdd )
+{
+	int col,row;
+
+	/* Look up crust-type number 2x2 deg tile. */
+	col =  (int)((90 - lat)/2);
+	row =  (int)((180 + lon)/2);
+
+	/* Switch debug messages from this function on/off (1/0). */
+	return crust_corr(ps, crust_type[col][row], lat, lon, depth, elev, dtdd, message_flag >= 5);
+}
+
+static double crust_corr (char ps, int c, double lat, double lon, double depth, double elev, double dtdd, int diagnostic )
 {
 	double g_vel,b_vel,n_vel,vel[8];
 	double crust_time,jb_crust_time;
@@ -45,17 +59,11 @@ double calc_crust_corr (char ps, double lat, double lon, double depth, double el
 	double iso_height,extra_mantle,iso_corr;
 	double uplift = 0.0, elev_diff = 0.0, elev_corr = 0.0;
 	double total_corr;
-	int c,col,row;
-	int i, diagnostic;
-
-	/* Switch debug messages from this function on/off (1/0). */
-	diagnostic = message_flag >= 5;
-//diagnostic = 1;
+	int col,row;
+	int i;
 
-	/* Look up crust-type number 2x2 deg tile. */
 	col =  (int)((90 - lat)/2);
 	row =  (int)((180 + lon)/2);
-	c = crust_type[col][row];
 
 	if (ps == 'P'){
 		g_vel = PGVEL;
@@ -216,4 +224,103 @@ double calc_crust_corr (char ps, double lat, double lon, double depth, double el
 }
 
 
+/*#DOC  Title:																*/
+/*#DOC    init_crust_corr_table / calc_crust_corr_source					*/
+/*#DOC  Desc:																*/
+/*#DOC    Tabulated source travel time correction for vertical rays			*/
+/*#DOC    (dtdd = 0), as used by NLLoc.										*/
+
+/* For dtdd = 0 the source correction of a crust type is linear in depth	*/
+/* between the layer boundaries and the J-B Conrad, and zero below the		*/
+/* Moho. It is tabulated at these depths once for each crust type and		*/
+/* phase, so linear interpolation gives the same correction as				*/
+/* calc_crust_corr() to within rounding error (< 1e-12 s).					*/
+
+#define NUM_CRUST_TYPES ((int) (sizeof(c_type) / sizeof(c_type[0])))
+#define MAX_CRUST_CORR_DEPTHS 8
+
+struct crust_corr_rec {
+	int ndepth;
+	double depth[MAX_CRUST_CORR_DEPTHS];	/* increasing depths of table */
+	double corr[MAX_CRUST_CORR_DEPTHS];		/* source correction at depth */
+	double depth_max;						/* no correction for deeper sources */
+};
+
+static struct crust_corr_rec crust_corr_table[2][NUM_CRUST_TYPES];
+static int crust_corr_table_init = 0;
+
+/* Build source correction table. Not thread safe, call before using		*/
+/* calc_crust_corr_source() from several threads.							*/
+
+void init_crust_corr_table (void)
+{
+	struct crust_corr_rec *ptable;
+	double bound[6], depth, cumulative_thick;
+	int nps, c, i, n, nbound;
+
+	if (crust_corr_table_init)
+		return;
+
+	for (c=0; c<NUM_CRUST_TYPES; c++){
+
+		/* Depths where the correction changes slope, sorted. */
+		nbound = 0;
+		bound[nbound++] = CONRAD;
+		cumulative_thick = 0;
+		for (i=2; i<7; i++){
+			cumulative_thick += c_type[c].thick[i];
+			depth = cumulative_thick;
+			for (n=nbound; n>0 && bound[n-1] > depth; n--)
+				bound[n] = bound[n-1];
+			bound[n] = depth;
+			nbound++;
+		}
+
+		for (nps=0; nps<2; nps++){
+			ptable = &crust_corr_table[nps][c];
+			ptable->depth_max = c_type[c].thick[8] < MOHO ? c_type[c].thick[8] : MOHO;
+
+			/* One depth above the slope changes, the slope changes above		*/
+			/* depth_max and depth_max.											*/
+			ptable->ndepth = 0;
+			ptable->depth[ptable->ndepth++] = (bound[0] < ptable->depth_max ? bound[0] : ptable->depth_max) - 10.0;
+			for (i=0; i<nbound; i++){
+				if (bound[i] < ptable->depth_max && bound[i] > ptable->depth[ptable->ndepth-1])
+					ptable->depth[ptable->ndepth++] = bound[i];
+			}
+			ptable->depth[ptable->ndepth++] = ptable->depth_max;
+
+			for (n=0; n<ptable->ndepth; n++)
+				ptable->corr[n] = crust_corr(nps ? 'S' : 'P', c, 0.0, 0.0, ptable->depth[n], VERY_LARGE_DOUBLE, 0.0, 0);
+		}
+	}
+
+	crust_corr_table_init = 1;
+}
+
+double calc_crust_corr_source (char ps, double lat, double lon, double depth )
+{
+	struct crust_corr_rec *ptable;
+	int col,row;
+	int n;
+
+	if (!crust_corr_table_init || (ps != 'P' && ps != 'S'))
+		return calc_crust_corr(ps, lat, lon, depth, VERY_LARGE_DOUBLE, 0.0);
+
+	/* Look up crust-type number 2x2 deg tile. */
+	col =  (int)((90 - lat)/2);
+	row =  (int)((180 + lon)/2);
+	ptable = &crust_corr_table[ps == 'S'][crust_type[col][row]];
+
+	if (depth > ptable->depth_max)
+		return 0.0;
+
+	/* Interpolate in depth, extrapolate above the top depth. */
+	for (n=1; n<ptable->ndepth-1 && depth > ptable->depth[n]; n++)
+		;
+	return ptable->corr[n-1] + (depth - ptable->depth[n-1])
+		* (ptable->corr[n] - ptable->corr[n-1]) / (ptable->depth[n] - ptable->depth[n-1]);
+}
+
+
 
@@ -1,2 +1,3 @@
 double calc_crust_corr (char ps, double lat, double lon, double depth, double elev, double dtdd );
-
+void init_crust_corr_table (void);
+double calc_crust_corr_source (char ps, double lat, double lon, double depth );
@@ -51,6 +51,173 @@ char *get_matrix_statistics_error_mesage() {
     return (error_message);
 }
 
+double GCDistanceAzimuth__(double latA, double lonA, double latB, double lonB, double *pazimuth);
+
+/** function to initialise a single pass sample statistics accumulator */
+
+void InitSampleStatistics(SampleStatistics *pstats, int global) {
+
+    memset(pstats, 0, sizeof (SampleStatistics));
+    pstats->global = global;
+
+}
+
+/** function to add a sample to a single pass sample statistics accumulator
+ *
+ * uses the Welford update, which avoids the precision loss of summing raw squares
+ *      and needs no prior knowledge of the expectation.
+ */
+
+void AddSampleStatistics(SampleStatistics *pstats, double x, double y, double z) {
+
+    double n, dx, dy, dz, fact;
+    double distance, azimuth;
+    double cx, cy;
+
+    if (pstats->global) {
+        if (!pstats->ref_set) {
+            pstats->xReference = x;
+            pstats->yReference = y;
+            pstats->ref_set = 1;
+        }
+        if (x - pstats->xReference > 180.0)
+            x -= 360.0;
+        else if (x - pstats->xReference < -180.0)
+            x += 360.0;
+    }
+
+    pstats->num_samples++;
+    n = (double) pstats->num_samples;
+
+    dx = x - pstats->mean.x;
+    dy = y - pstats->mean.y;
+    dz = z - pstats->mean.z;
+    pstats->mean.x += dx / n;
+    pstats->mean.y += dy / n;
+    pstats->mean.z += dz / n;
+
+    if (pstats->global) {
+        // see CalcCovarianceSamplesGlobal(), here distance and azimuth are taken from the reference point
+        distance = GCDistanceAzimuth__(pstats->yReference, pstats->xReference, y, x, &azimuth);
+        distance *= DEG2KM;
+        cx = distance * sin(azimuth * DE2RA); // azimuth is deg CW from North
+        cy = distance * cos(azimuth * DE2RA);
+        dx = cx - pstats->mean_km.x;
+        dy = cy - pstats->mean_km.y;
+        pstats->mean_km.x += dx / n;
+        pstats->mean_km.y += dy / n;
+    }
+
+    fact = (n - 1.0) / n;
+    pstats->comoment.xx += fact * dx * dx;
+    pstats->comoment.xy += fact * dx * dy;
+    pstats->comoment.xz += fact * dx * dz;
+    pstats->comoment.yy += fact * dy * dy;
+    pstats->comoment.yz += fact * dy * dz;
+    pstats->comoment.zz += fact * dz * dz;
+
+}
+
+/** function to get the expectation (mean) from a single pass sample statistics accumulator */
+
+Vect3D GetSampleStatisticsExpectation(SampleStatistics *pstats) {
+
+    Vect3D expect = pstats->mean;
+
+    if (pstats->global) {
+        if (expect.x < -180.0)
+            expect.x += 360.0;
+        else if (expect.x > 180.0)
+            expect.x -= 360.0;
+    }
+
+    return (expect);
+}
+
+/** function to get the covariance from a single pass sample statistics accumulator
+ *
+ * covariance is normalised by the number of samples, as in CalcCovarianceSamplesRect()
+ */
+
+Mtrx3D GetSampleStatisticsCovariance(SampleStatistics *pstats) {
+
+    Mtrx3D cov = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    double n;
+
+    if (pstats->num_samples < 1)
+        return (cov);
+
+    n = (double) pstats->num_samples;
+
+    cov.xx = pstats->comoment.xx / n;
+    cov.xy = pstats->comoment.xy / n;
+    cov.xz = pstats->comoment.xz / n;
+
+    cov.yx = cov.xy;
+    cov.yy = pstats->comoment.yy / n;
+    cov.yz = pstats->comoment.yz / n;
+
+    cov.zx = cov.xz;
+    cov.zy = cov.yz;
+    cov.zz = pstats->comoment.zz / n;
+
+    return (cov);
+}
+
+/** function to calculate the Gelman-Rubin potential scale reduction factor of x, y and z for several chains of samples
+ *
+ * values near 1 indicate that the chains have converged to the same distribution, -1 if not defined.
+ * see Gelman & Rubin (1992), Statistical Science 7, 457-472.
+ */
+
+Vect3D CalcGelmanRubinSamples(float** fdata, int* nSamples, int nChains) {
+
+    int nchain, nsamp, ipos, ncoord;
+    double n_mean = 0.0;
+    double mean[3], mean_sum[3] = {0.0, 0.0, 0.0}, mean_sqr_sum[3] = {0.0, 0.0, 0.0};
+    double var_sum[3] = {0.0, 0.0, 0.0};
+    double value, within, between, var_est, rhat[3];
+    Vect3D result = {-1.0, -1.0, -1.0};
+
+    if (nChains < 2)
+        return (result);
+
+    for (nchain = 0; nchain < nChains; nchain++) {
+        if (nSamples[nchain] < 2)
+            return (result);
+        n_mean += (double) nSamples[nchain];
+        // chain mean and variance
+        for (ncoord = 0; ncoord < 3; ncoord++) {
+            mean[ncoord] = 0.0;
+            for (nsamp = 0, ipos = ncoord; nsamp < nSamples[nchain]; nsamp++, ipos += 4)
+                mean[ncoord] += fdata[nchain][ipos];
+            mean[ncoord] /= (double) nSamples[nchain];
+            value = 0.0;
+            for (nsamp = 0, ipos = ncoord; nsamp < nSamples[nchain]; nsamp++, ipos += 4)
+                value += (fdata[nchain][ipos] - mean[ncoord]) * (fdata[nchain][ipos] - mean[ncoord]);
+            var_sum[ncoord] += value / (double) (nSamples[nchain] - 1);
+            mean_sum[ncoord] += mean[ncoord];
+            mean_sqr_sum[ncoord] += mean[ncoord] * mean[ncoord];
+        }
+    }
+    n_mean /= (double) nChains;
+
+    for (ncoord = 0; ncoord < 3; ncoord++) {
+        within = var_sum[ncoord] / (double) nChains;
+        // between chain variance divided by number of samples
+        between = (mean_sqr_sum[ncoord] - mean_sum[ncoord] * mean_sum[ncoord] / (double) nChains) / (double) (nChains - 1);
+        if (between < 0.0)
+            between = 0.0;
+        var_est = (n_mean - 1.0) / n_mean * within + between;
+        rhat[ncoord] = within > SMALL_DOUBLE ? sqrt(var_est / within) : -1.0;
+    }
+    result.x = rhat[0];
+    result.y = rhat[1];
+    result.z = rhat[2];
+
+    return (result);
+}
+
 /** function to calculate the expectation (mean)  of a set of samples */
 
 Vect3D CalcExpectationSamples(float* fdata, int nSamples) {
@@ -39,7 +39,29 @@ typedef struct {
 
 
 
+/** single pass (Welford) accumulator for expectation and covariance of a sample stream
+ *
+ * For the global case the covariance is accumulated in km on a local tangent plane
+ * centred on the reference point (by default the first sample), x east, y north.
+ */
+
+typedef struct {
+    long num_samples;
+    int global;
+    int ref_set;
+    double xReference, yReference; // global case: reference longitude / latitude
+    Vect3D mean; // running mean of x, y, z (longitude wrapped to xReference for global case)
+    Vect3D mean_km; // running mean of tangent plane coordinates (global case)
+    Mtrx3D comoment; // running sums of products of deviations from mean
+} SampleStatistics;
+
+
 char *get_matrix_statistics_error_mesage();
+void InitSampleStatistics(SampleStatistics *pstats, int global);
+void AddSampleStatistics(SampleStatistics *pstats, double x, double y, double z);
+Vect3D GetSampleStatisticsExpectation(SampleStatistics *pstats);
+Mtrx3D GetSampleStatisticsCovariance(SampleStatistics *pstats);
+Vect3D CalcGelmanRubinSamples(float** fdata, int* nSamples, int nChains);
 Vect3D CalcExpectationSamples(float*, int);
 Vect3D CalcExpectationSamplesWeighted(float* fdata, int nSamples);
 Vect3D CalcExpectationSamplesGlobal(float* fdata, int nSamples, double xReference);
@@ -49,14 +49,95 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 #include "ran1.h"
 #include "octtree.h"
 
-/*** function to create a new OctNode */
+/*** function to create a new NodePool for nodes of size node_size, allocated in blocks of block_size nodes */
 
-OctNode* newOctNode(OctNode* parent, Vect3D center, Vect3D ds, double value, void *pdata) {
+NodePool* newNodePool(size_t node_size, int block_size) {
+
+    NodePool* pool;
+
+    if ((pool = (NodePool*) malloc(sizeof (NodePool))) == NULL)
+        return (NULL);
+
+    pool->node_size = node_size;
+    pool->block_size = block_size > 0 ? block_size : NODE_POOL_BLOCK_SIZE;
+    pool->first = NULL;
+    pool->current = NULL;
+
+    return (pool);
+}
+
+/*** function to get address of node inode in a NodePool block */
+
+static char* getNodePoolBlockNode(NodePool* pool, NodePoolBlock* block, int inode) {
+
+    return ((char*) block + sizeof (NodePoolBlock) + (size_t) inode * pool->node_size);
+}
+
+/*** function to take a new node from a NodePool, previously allocated blocks are re-used after resetNodePool() */
+
+void* allocNodePoolNode(NodePool* pool) {
+
+    NodePoolBlock* block = pool->current;
+
+    if (block == NULL || block->num_used >= pool->block_size) {
+        if (block != NULL && block->next != NULL) { // re-use block retained by reset
+            block = block->next;
+        } else {
+            block = (NodePoolBlock*) malloc(sizeof (NodePoolBlock) + (size_t) pool->block_size * pool->node_size);
+            if (block == NULL)
+                return (NULL);
+            block->next = NULL;
+            if (pool->current == NULL)
+                pool->first = block;
+            else
+                pool->current->next = block;
+        }
+        block->num_used = 0;
+        pool->current = block;
+    }
+
+    return (getNodePoolBlockNode(pool, block, block->num_used++));
+}
+
+/*** function to release all nodes of a NodePool, allocated blocks are kept for re-use */
+
+void resetNodePool(NodePool* pool) {
+
+    if (pool == NULL)
+        return;
+
+    pool->current = pool->first;
+    if (pool->current != NULL)
+        pool->current->num_used = 0;
+}
+
+/*** function to free a NodePool and all its nodes */
+
+void freeNodePool(NodePool* pool) {
+
+    if (pool == NULL)
+        return;
+
+    NodePoolBlock* block = pool->first;
+    while (block != NULL) {
+        NodePoolBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(pool);
+}
+
+/*** function to create a new OctNode, taken from pool if pool != NULL */
+
+OctNode* newOctNode(NodePool* pool, OctNode* parent, Vect3D center, Vect3D ds, double value, void *pdata) {
 
     int l, m, n;
     OctNode* node;
 
-    node = (OctNode*) malloc(sizeof (OctNode));
+    if (pool != NULL)
+        node = (OctNode*) allocNodePoolNode(pool);
+    else
+        node = (OctNode*) malloc(sizeof (OctNode));
 
     node->parent = parent;
     node->center = center;
@@ -92,11 +173,31 @@ void freeTree3D(Tree3D* tree, int freeDataPointer) {
 
     int ix, iy, iz;
 
+    if (tree->nodePool != NULL) {
+        // all nodes are in pool, only node data must be freed individually
+        if (freeDataPointer) {
+            NodePoolBlock* block;
+            for (block = tree->nodePool->first; block != NULL; block = block->next) {
+                int inode;
+                for (inode = 0; inode < block->num_used; inode++) {
+                    OctNode* node = (OctNode*) getNodePoolBlockNode(tree->nodePool, block, inode);
+                    if (node->pdata != NULL)
+                        free(node->pdata);
+                }
+                if (block == tree->nodePool->current)
+                    break;
+            }
+        }
+        freeNodePool(tree->nodePool);
+    }
+
     for (ix = 0; ix < tree->numx; ix++) {
         for (iy = 0; iy < tree->numy; iy++) {
-            for (iz = 0; iz < tree->numz; iz++) {
-                if (tree->nodeArray[ix][iy][iz] != NULL) // case of Tree3D_spherical
-                    freeNode(tree->nodeArray[ix][iy][iz], freeDataPointer);
+            if (tree->nodePool == NULL) {
+                for (iz = 0; iz < tree->numz; iz++) {
+                    if (tree->nodeArray[ix][iy][iz] != NULL) // case of Tree3D_spherical
+                        freeNode(tree->nodeArray[ix][iy][iz], freeDataPointer);
+                }
             }
             free(tree->nodeArray[ix][iy]);
         }
@@ -134,6 +235,8 @@ Tree3D* newTree3D(int data_code, int numx, int numy, int numz,
     }
     tree->ds_x = NULL;
     tree->num_x = NULL;
+    // nodes of tree are allocated contiguously from pool, falls back to individual allocation
+    tree->nodePool = newNodePool(sizeof (OctNode), NODE_POOL_BLOCK_SIZE);
 
     ds.x = dx;
     ds.y = dy;
@@ -151,7 +254,7 @@ Tree3D* newTree3D(int data_code, int numx, int numy, int numz,
                 return (NULL);
             for (iz = 0; iz < numz; iz++) {
                 center.z = origz + (double) iz * dz + dz / 2.0;
-                garray[ix][iy][iz] = newOctNode(NULL, center, ds, value, pdata);
+                garray[ix][iy][iz] = newOctNode(tree->nodePool, NULL, center, ds, value, pdata);
             }
         }
     }
@@ -218,6 +321,8 @@ Tree3D* newTree3D_spherical(int data_code, int numx_nominal, int numy, int numz,
         free(tree);
         return (NULL);
     }
+    // nodes of tree are allocated contiguously from pool, falls back to individual allocation
+    tree->nodePool = newNodePool(sizeof (OctNode), NODE_POOL_BLOCK_SIZE);
 
     ds.x = dx_nominal;
     ds.y = dy;
@@ -248,7 +353,7 @@ Tree3D* newTree3D_spherical(int data_code, int numx_nominal, int numy, int numz,
                     ds.x = dx;
                     center.x = origx + (double) ix * dx + dx / 2.0;
                     center.z = origz + (double) iz * dz + dz / 2.0;
-                    garray[ix][iy][iz] = newOctNode(NULL, center, ds, value, pdata);
+                    garray[ix][iy][iz] = newOctNode(tree->nodePool, NULL, center, ds, value, pdata);
                 } else {
                     garray[ix][iy][iz] = NULL;
                 }
@@ -287,9 +392,9 @@ double get_dx_spherical(double dx_nominal, double origx, double x_max, double ce
 
 }
 
-/*** function to subdivide a node into child nodes ***/
+/*** function to subdivide a node into child nodes, child nodes taken from pool if pool != NULL ***/
 
-void subdivide(OctNode* parent, double value, void *pdata) {
+void subdivide(NodePool* pool, OctNode* parent, double value, void *pdata) {
 
     int ix, iy, iz;
     Vect3D center, ds;
@@ -306,7 +411,7 @@ void subdivide(OctNode* parent, double value, void *pdata) {
             center.y = parent->center.y + (double) (2 * iy - 1) * ds.y / 2.0;
             for (iz = 0; iz < 2; iz++) {
                 center.z = parent->center.z + (double) (2 * iz - 1) * ds.z / 2.0;
-                parent->child[ix][iy][iz] = newOctNode(parent, center, ds, value, pdata);
+                parent->child[ix][iy][iz] = newOctNode(pool, parent, center, ds, value, pdata);
             }
         }
     }
@@ -316,7 +421,7 @@ void subdivide(OctNode* parent, double value, void *pdata) {
 
 }
 
-/*** function to free an OctNode and all its child nodes ***/
+/*** function to free an OctNode and all its child nodes, nodes must not be taken from a NodePool ***/
 
 void freeNode(OctNode* node, int freeDataPointer) {
 
@@ -521,38 +626,108 @@ int extendedNodeContains(OctNode* node, double x, double y, double z, int checkZ
 
 }
 
-/*** function to put Octtree node in results tree in order of value */
+/*** functions to keep results tree height balanced (AVL)
+ *  rotations preserve the in-order sequence of the tree, thus the traversal order of all
+ *  results tree functions is identical to that of the unbalanced tree */
+
+static int getResultTreeHeight(ResultTreeNode* prtree) {
+
+    return (prtree == NULL ? 0 : prtree->height);
+}
+
+static void updateResultTreeHeight(ResultTreeNode* prtree) {
+
+    int height_left = getResultTreeHeight(prtree->left);
+    int height_right = getResultTreeHeight(prtree->right);
+
+    prtree->height = 1 + (height_left > height_right ? height_left : height_right);
+}
+
+static ResultTreeNode* rotateResultTreeRight(ResultTreeNode* prtree) {
+
+    ResultTreeNode* pnew_root = prtree->left;
+
+    prtree->left = pnew_root->right;
+    pnew_root->right = prtree;
+    updateResultTreeHeight(prtree);
+    updateResultTreeHeight(pnew_root);
+
+    return (pnew_root);
+}
+
+static ResultTreeNode* rotateResultTreeLeft(ResultTreeNode* prtree) {
+
+    ResultTreeNode* pnew_root = prtree->right;
+
+    prtree->right = pnew_root->left;
+    pnew_root->left = prtree;
+    updateResultTreeHeight(prtree);
+    updateResultTreeHeight(pnew_root);
+
+    return (pnew_root);
+}
+
+static ResultTreeNode* balanceResultTree(ResultTreeNode* prtree) {
+
+    updateResultTreeHeight(prtree);
+
+    int balance = getResultTreeHeight(prtree->left) - getResultTreeHeight(prtree->right);
+
+    if (balance > 1) {
+        if (getResultTreeHeight(prtree->left->left) < getResultTreeHeight(prtree->left->right))
+            prtree->left = rotateResultTreeLeft(prtree->left);
+        return (rotateResultTreeRight(prtree));
+    }
+    if (balance < -1) {
+        if (getResultTreeHeight(prtree->right->right) < getResultTreeHeight(prtree->right->left))
+            prtree->right = rotateResultTreeRight(prtree->right);
+        return (rotateResultTreeLeft(prtree));
+    }
+
+    return (prtree);
+}
+
+/*** function to put Octtree node in results tree in order of value
+ *  nodes with value equal to an existing node are placed after (higher than) the existing node,
+ *  tree is kept height balanced, returns new root of tree
+ *  result tree node taken from pool if pool != NULL, such a tree is released with the pool, not with freeResultTree() */
 
-ResultTreeNode* addResult(ResultTreeNode* prtree, double value, double volume, OctNode* pnode) {
+ResultTreeNode* addResult(NodePool* pool, ResultTreeNode* prtree, double value, double volume, OctNode* pnode) {
 
     // put address in result tree based on value
 
     if (prtree == NULL) { // at empty node
-        if ((prtree = (ResultTreeNode*) malloc(sizeof (ResultTreeNode))) == NULL)
+        if (pool != NULL)
+            prtree = (ResultTreeNode*) allocNodePoolNode(pool);
+        else
+            prtree = (ResultTreeNode*) malloc(sizeof (ResultTreeNode));
+        if (prtree == NULL)
             fprintf(stderr, "ERROR allocating memory for result-tree node.\n");
         prtree->value = value;
         prtree->level = pnode->level;
         prtree->volume = volume; // node volume depends on geometry in physical space, may not be dx*dy*dz
         prtree->pnode = pnode;
         prtree->left = prtree->right = NULL;
+        prtree->height = 1;
+        return (prtree);
 
         /* 20101213 AJL removed this block - causes memory errors in trace_processing/location.c
            } else if (value == prtree->value) { // prevent assymetric tree if multiple identical values
             if (get_rand_int(-10000, 9999) < 0)
-                prtree->left = addResult(prtree->left, value, volume, pnode);
+                prtree->left = addResult(pool, prtree->left, value, volume, pnode);
             else
-                prtree->right = addResult(prtree->right, value, volume, pnode);
+                prtree->right = addResult(pool, prtree->right, value, volume, pnode);
          */
 
     } else if (value < prtree->value) {
-        prtree->left = addResult(prtree->left, value, volume, pnode);
+        prtree->left = addResult(pool, prtree->left, value, volume, pnode);
 
     } else {
 
-        prtree->right = addResult(prtree->right, value, volume, pnode);
+        prtree->right = addResult(pool, prtree->right, value, volume, pnode);
     }
 
-    return (prtree);
+    return (balanceResultTree(prtree));
 }
 
 /*** function to free results tree */
@@ -833,7 +1008,7 @@ Tree3D* readTree3D(FILE *fpio) {
         for (iy = 0; iy < tree->numy; iy++) {
             for (iz = 0; iz < tree->numz; iz++) {
                 if (tree->nodeArray[ix][iy][iz] != NULL) {
-                    istat = readNode(fpio, tree->nodeArray[ix][iy][iz]);
+                    istat = readNode(fpio, tree->nodePool, tree->nodeArray[ix][iy][iz]);
                     if (istat < 0)
                         return (NULL);
                     istat_cum += istat;
@@ -852,7 +1027,7 @@ Tree3D* readTree3D(FILE *fpio) {
 
 //static double maxvalue = -1.0;
 
-int readNode(FILE *fpio, OctNode* node) {
+int readNode(FILE *fpio, NodePool* pool, OctNode* node) {
 
     int istat;
     int istat_cum;
@@ -892,7 +1067,7 @@ int readNode(FILE *fpio, OctNode* node) {
     if (node->isLeaf)
         return (1);
 
-    subdivide(node, -1.0, NULL);
+    subdivide(pool, node, -1.0, NULL);
 
     istat_cum = 1;
 
@@ -900,7 +1075,7 @@ int readNode(FILE *fpio, OctNode* node) {
         for (iy = 0; iy < 2; iy++) {
             for (iz = 0; iz < 2; iz++) {
                 if (node->child[ix][iy][iz] != NULL) {
-                    istat = readNode(fpio, node->child[ix][iy][iz]);
+                    istat = readNode(fpio, pool, node->child[ix][iy][iz]);
                     if (istat < 0)
                         return (-1);
                     istat_cum += istat;
@@ -1256,7 +1431,7 @@ ResultTreeNode * createResultTree(ResultTreeNode* prtree, ResultTreeNode * pnew_
 
     pnode = prtree->pnode;
     if (pnode->isLeaf) {
-        pnew_rtree = addResult(pnew_rtree, pnode->value, prtree->volume, pnode);
+        pnew_rtree = addResult(NULL, pnew_rtree, pnode->value, prtree->volume, pnode);
     }
 
     if (prtree->right != NULL)
@@ -70,6 +70,25 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 #define VALUE_IS_PROB_DENSITY_IN_NODE 1     // pdf (does not take into account volume of cell)
 #define VALUE_IS_PROBABILITY_IN_NODE 2     // pdf * cell volume (takes into account volume of cell)
 
+/* pool of fixed size nodes, allocated in contiguous blocks and released all at once */
+
+#define NODE_POOL_BLOCK_SIZE 4096	/* default number of nodes per pool block */
+
+typedef struct nodePoolBlock
+{
+	struct nodePoolBlock* next;	/* next block in pool */
+	int num_used;			/* number of nodes used in this block, nodes follow block header */
+} NodePoolBlock;
+
+typedef struct
+{
+	size_t node_size;		/* size of one node (bytes) */
+	int block_size;			/* number of nodes per block */
+	NodePoolBlock* first;		/* first block */
+	NodePoolBlock* current;		/* block nodes are currently taken from, following blocks are unused */
+} NodePool;
+
+
 /* octree node */
 
 typedef struct octnode* OctNodePtr;
@@ -100,6 +119,7 @@ typedef struct
         int* num_x;                 // array of true num_x values for spherical case
 	double integral;
         int isSpherical;            // =1 if Tree3D is spherical, 0 otherwise
+        NodePool* nodePool;         // pool holding all OctNodes of this tree, NULL if nodes allocated individually
 }
 Tree3D;
 
@@ -114,6 +134,7 @@ typedef struct resultTreeNode {
 	int level;			/* level of node in oect-tree hierarchy (0 = top, largest) */
 	double volume;		/* volume, node volume depends on geometry in physical space, may not be dx*dy*dz */
 	OctNode* pnode;			/* corresponding octree node */
+	int height;			/* height of subtree rooted at this node, used to keep tree balanced */
 } ResultTreeNode;
 
 
@@ -139,6 +160,11 @@ typedef struct resultTreeNode {
 /* function declarations */
 /*------------------------------------------------------------/ */
 
+NodePool* newNodePool(size_t node_size, int block_size);
+void* allocNodePoolNode(NodePool* pool);
+void resetNodePool(NodePool* pool);
+void freeNodePool(NodePool* pool);
+
 Tree3D* newTree3D(int data_code, int numx, int numy, int numz,
 	double origx, double origy, double origz,
 	double dx,  double dy,  double dz, double value, double integral, void *pdata);
@@ -146,15 +172,15 @@ Tree3D* newTree3D_spherical(int data_code, int numx_nominal, int numy, int numz,
         double origx, double origy, double origz,
         double dx_nominal, double dy, double dz, double value, double integral, void *pdata);
 double get_dx_spherical(double dx_nominal, double origx, double x_max, double center_y, int *pnum_x);
-OctNode* newOctNode(OctNode* parent, Vect3D center, Vect3D ds, double value, void *pdata);
-void subdivide(OctNode* parent, double value, void *pdata);
+OctNode* newOctNode(NodePool* pool, OctNode* parent, Vect3D center, Vect3D ds, double value, void *pdata);
+void subdivide(NodePool* pool, OctNode* parent, double value, void *pdata);
 void freeTree3D(Tree3D* tree, int freeDataPointer);
 void freeNode(OctNode* node, int freeDataPointer);
 OctNode* getTreeNodeContaining(Tree3D* tree, Vect3D coords, double *padjusted_coords_x);
 OctNode* getLeafNodeContaining(Tree3D* tree, Vect3D coords);
 OctNode* getLeafContaining(OctNode* node, double x, double y, double z);
 
-ResultTreeNode* addResult(ResultTreeNode* prtn, double value, double volume, OctNode* pnode);
+ResultTreeNode* addResult(NodePool* pool, ResultTreeNode* prtn, double value, double volume, OctNode* pnode);
 void freeResultTree(ResultTreeNode* prtn);
 ResultTreeNode* getHighestValue(ResultTreeNode* prtn);
 ResultTreeNode* getHighestLeafValue(ResultTreeNode* prtree);
@@ -166,7 +192,7 @@ ResultTreeNode* getHighestLeafValueLESpecifiedLevel(ResultTreeNode* prtree, int
 ResultTreeNode* getHighestLeafValueGESpecifiedLevel(ResultTreeNode* prtree, int level);
 
 Tree3D* readTree3D(FILE *fpio);
-int readNode(FILE *fpio, OctNode* node);
+int readNode(FILE *fpio, NodePool* pool, OctNode* node);
 int writeTree3D(FILE *fpio, Tree3D* tree);
 int writeNode(FILE *fpio, OctNode* node);
 
@@ -99,11 +99,12 @@ void test_rand_int()
 
 /*
  *	Global variables for rstart & uni
+ *	thread local, so that each thread can draw from its own stream (see uni_get_state)
  */
 
-double uni_u[98];	/* Was U(97) in Fortran version -- too lazy to fix */
-double uni_c, uni_cd, uni_cm;
-int uni_ui, uni_uj;
+static __thread double uni_u[98];	/* Was U(97) in Fortran version -- too lazy to fix */
+static __thread double uni_c, uni_cd, uni_cm;
+static __thread int uni_ui, uni_uj;
 
  double uni(void)
 {
@@ -235,3 +236,34 @@ void rinit(int ijkl)
 }
 
 
+
+/*** function to save the UNI generator state of the calling thread */
+
+void uni_get_state(UniState* pstate)
+{
+	int n;
+
+	for (n = 0; n < 98; n++)
+		pstate->u[n] = uni_u[n];
+	pstate->c = uni_c;
+	pstate->cd = uni_cd;
+	pstate->cm = uni_cm;
+	pstate->ui = uni_ui;
+	pstate->uj = uni_uj;
+}
+
+
+/*** function to restore the UNI generator state of the calling thread */
+
+void uni_set_state(const UniState* pstate)
+{
+	int n;
+
+	for (n = 0; n < 98; n++)
+		uni_u[n] = pstate->u[n];
+	uni_c = pstate->c;
+	uni_cd = pstate->cd;
+	uni_cm = pstate->cm;
+	uni_ui = pstate->ui;
+	uni_uj = pstate->uj;
+}
@@ -70,9 +70,18 @@ double ran1(int* idum);
 
 /*//////// UNI stuff */
 
+/* UNI generator state, the generator state is kept per thread */
+typedef struct {
+	double u[98];
+	double c, cd, cm;
+	int ui, uj;
+} UniState;
+
 double uni(void);
 void rstart(int i, int j, int k, int l);
 void rinit(int ijkl);
+void uni_get_state(UniState* pstate);
+void uni_set_state(const UniState* pstate);
 
 
 #endif
@@ -42,11 +42,22 @@ extern "C" {
 #include <seiscomp/math/vector3.h>
 #include <seiscomp/utils/files.h>
 #include <seiscomp/utils/replace.h>
+#include <seiscomp/utils/timer.h>
 
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
 #include <set>
+#include <thread>
+
+#include <sys/stat.h>
 
 
 ADD_SC_PLUGIN(
@@ -298,6 +309,90 @@ double normalizeLon(double lon) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+vector<string>::iterator findParameterLine(vector<string> &params,
+                                           const char *name) {
+	size_t len = strlen(name);
+	for ( vector<string>::iterator it = params.begin(); it != params.end(); ++it ) {
+		if ( it->compare(0, len, name) != 0 ) continue;
+		if ( it->size() == len || isspace((*it)[len]) )
+			return it;
+	}
+
+	return params.end();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+string joinTokens(const vector<string> &toks) {
+	string line;
+	for ( size_t i = 0; i < toks.size(); ++i ) {
+		if ( i > 0 ) line += ' ';
+		line += toks[i];
+	}
+	return line;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Reads number of nodes, origin and spacing of the three axes from a
+// LOCGRID line.
+bool parseLocGrid(const string &line, vector<string> &toks,
+                  int num[3], double orig[3], double step[3]) {
+	Core::split(toks, line.c_str(), " \t\r\n", true);
+	if ( toks.size() < 10 ) return false;
+
+	for ( int i = 0; i < 3; ++i ) {
+		if ( !fromString(num[i], toks[1+i]) ||
+		     !fromString(orig[i], toks[4+i]) ||
+		     !fromString(step[i], toks[7+i]) )
+			return false;
+	}
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool isLocated(const LocNode *node) {
+	return node != nullptr &&
+	       strcmp(node->plocation->phypo->locStat, "LOCATED") == 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// Keeps the travel time grids loaded by NLLoc in memory while an instance
+// is in scope and releases them afterwards.
+struct GridMemoryCache {
+	GridMemoryCache(bool enable) : enabled(enable) {
+		if ( enabled ) GridMemListPersistent = 1;
+	}
+
+	~GridMemoryCache() {
+		if ( enabled ) {
+			GridMemListPersistent = 0;
+			NLL_FreeGridMemory();
+		}
+	}
+
+	bool enabled;
+};
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 std::string stationName(const Seiscomp::DataModel::Pick *pick, const std::string& rule)
 {
@@ -324,6 +419,29 @@ std::string stationName(const Seiscomp::DataModel::Pick *pick, const std::string
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Captures everything written by func to a stdio stream in buffer.
+template <typename F>
+bool writeToBuffer(std::string &buffer, F func) {
+	char *data = nullptr;
+	size_t size = 0;
+
+	FILE *fp = open_memstream(&data, &size);
+	if ( fp == nullptr ) return false;
+
+	bool ok = func(fp);
+	if ( fclose(fp) != 0 ) ok = false;
+
+	if ( ok ) buffer.assign(data, size);
+	free(data);
+
+	return ok;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 } // private namespace
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -331,6 +449,185 @@ std::string stationName(const Seiscomp::DataModel::Pick *pick, const std::string
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Writes the NLL artefacts of a location to disk. The artefacts are
+// rendered to memory in the locator thread because the NLL data structures
+// and globals are only valid there. With a background thread, disk i/o
+// happens asynchronously and the amount of queued data is bounded.
+//
+// A bundle is a single file <publicID>.nll.bundle with the layout (all
+// integers little endian):
+//   char[8]  magic "NLLBNDL1"
+//   uint32   number of entries
+//   per entry:
+//     uint32 name length, name (e.g. "loc.hyp")
+//     uint64 data length, data (content of the file <publicID>.<name>)
+class NLLocator::OutputWriter {
+	public:
+		struct Artefact {
+			std::string name;
+			std::string data;
+		};
+
+		struct Job {
+			std::string           path;
+			std::vector<Artefact> artefacts;
+
+			size_t size() const {
+				size_t bytes = 0;
+				for ( const auto &artefact : artefacts )
+					bytes += artefact.data.size();
+				return bytes;
+			}
+		};
+
+	public:
+		OutputWriter(bool async, bool bundle, size_t maxQueuedBytes)
+		: _async(async), _bundle(bundle), _maxQueuedBytes(maxQueuedBytes) {}
+
+		~OutputWriter() {
+			flush();
+		}
+
+		//! Writes all pending jobs and stops the background thread. It is
+		//! started again with the next job.
+		void flush() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_shutdown = true;
+			}
+			_wakeUp.notify_all();
+			if ( _thread.joinable() )
+				_thread.join();
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_shutdown = false;
+		}
+
+		void push(Job &&job) {
+			if ( job.artefacts.empty() ) return;
+
+			if ( !_async ) {
+				write(job);
+				return;
+			}
+
+			size_t bytes = job.size();
+
+			std::unique_lock<std::mutex> lock(_mutex);
+			if ( !_thread.joinable() )
+				_thread = std::thread(&OutputWriter::run, this);
+
+			// Bound the memory used by the queue. A job larger than the
+			// limit is accepted if the queue is empty.
+			if ( _queuedBytes > 0 && _queuedBytes + bytes > _maxQueuedBytes ) {
+				SEISCOMP_WARNING("NLL output queue full, waiting for %d pending "
+				                 "location(s) to be written", (int)_queue.size());
+				_spaceAvailable.wait(lock, [this, bytes] {
+					return _queuedBytes == 0 || _queuedBytes + bytes <= _maxQueuedBytes;
+				});
+			}
+
+			_queuedBytes += bytes;
+			_queue.push_back(std::move(job));
+			lock.unlock();
+			_wakeUp.notify_one();
+		}
+
+	private:
+		void run() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			while ( true ) {
+				_wakeUp.wait(lock, [this] { return _shutdown || !_queue.empty(); });
+				// Write all pending jobs before leaving
+				if ( _queue.empty() ) break;
+
+				Job job = std::move(_queue.front());
+				_queue.pop_front();
+				lock.unlock();
+
+				write(job);
+				size_t bytes = job.size();
+
+				lock.lock();
+				_queuedBytes -= bytes;
+				_spaceAvailable.notify_all();
+			}
+		}
+
+		void write(const Job &job) const {
+			if ( _bundle ) {
+				writeBundle(job);
+				return;
+			}
+
+			for ( const auto &artefact : job.artefacts ) {
+				string filename = job.path + "." + artefact.name;
+				FILE *fp = fopen(filename.c_str(), "wb");
+				if ( fp == nullptr ) {
+					SEISCOMP_ERROR("Failed writing NLL output file: %s", filename.c_str());
+					continue;
+				}
+
+				if ( fwrite(artefact.data.data(), 1, artefact.data.size(), fp) != artefact.data.size() )
+					SEISCOMP_ERROR("Failed writing NLL output file: %s", filename.c_str());
+
+				fclose(fp);
+			}
+		}
+
+		void writeBundle(const Job &job) const {
+			string filename = job.path + ".nll.bundle";
+			FILE *fp = fopen(filename.c_str(), "wb");
+			if ( fp == nullptr ) {
+				SEISCOMP_ERROR("Failed writing NLL output bundle: %s", filename.c_str());
+				return;
+			}
+
+			bool ok = fwrite("NLLBNDL1", 1, 8, fp) == 8
+			       && writeInt(fp, (uint32_t)job.artefacts.size());
+
+			for ( const auto &artefact : job.artefacts ) {
+				if ( !ok ) break;
+				ok = writeInt(fp, (uint32_t)artefact.name.size())
+				  && fwrite(artefact.name.data(), 1, artefact.name.size(), fp) == artefact.name.size()
+				  && writeInt(fp, (uint64_t)artefact.data.size())
+				  && fwrite(artefact.data.data(), 1, artefact.data.size(), fp) == artefact.data.size();
+			}
+
+			if ( fclose(fp) != 0 ) ok = false;
+
+			if ( !ok )
+				SEISCOMP_ERROR("Failed writing NLL output bundle: %s", filename.c_str());
+		}
+
+		template <typename T>
+		static bool writeInt(FILE *fp, T value) {
+			unsigned char bytes[sizeof(T)];
+			for ( size_t i = 0; i < sizeof(T); ++i ) {
+				bytes[i] = (unsigned char)(value & 0xff);
+				value >>= 8;
+			}
+			return fwrite(bytes, 1, sizeof(T), fp) == sizeof(T);
+		}
+
+	private:
+		bool                    _async;
+		bool                    _bundle;
+		size_t                  _maxQueuedBytes;
+		size_t                  _queuedBytes{0};
+		bool                    _shutdown{false};
+		std::deque<Job>         _queue;
+		std::mutex              _mutex;
+		std::condition_variable _wakeUp;
+		std::condition_variable _spaceAvailable;
+		std::thread             _thread;
+};
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 REGISTER_LOCATOR(NLLocator, "NonLinLoc");
 
@@ -357,10 +654,17 @@ NLLocator::NLLocator() {
 
 	_defaultPickError = 0.5;
 	_fixedDepthGridSpacing = 0.1;
+	_warmStartRadius = 50.0;
+	_enableDistanceCutOffWarmStart = false;
+	_enableInitialWarmStart = false;
+	_enableMapGrids = false;
 	_allowMissingStations = true;
 	_enableSEDParameters = false;
 	_enableNLLOutput = true;
 	_enableNLLSaveInput = true;
+	_enableAsyncOutput = true;
+	_enableOutputBundle = false;
+	_outputQueueSize = 64;
 
 	_SEDdiffMaxLikeExpectTag = "SED.diffMaxLikeExpect";
 	_SEDqualityTag = "SED.quality";
@@ -428,6 +732,7 @@ bool NLLocator::init(const Config::Config &config) {
 	}
 
 	_currentProfile = nullptr;
+	_sensorLocationCache.clear();
 	bool result = true;
 
 	_profileNames.clear();
@@ -441,6 +746,10 @@ bool NLLocator::init(const Config::Config &config) {
 		string prefix = string("NonLinLoc.profile.") + *it + ".";
 
 		prof.name = *it;
+		prof.controlFileMTime.tv_sec = 0;
+		prof.controlFileMTime.tv_nsec = 0;
+		prof.controlFileSize = 0;
+		prof.controlFileLoaded = false;
 
 		try { prof.earthModelID = config.getString(prefix + "earthModelID"); }
 		catch ( ... ) {}
@@ -501,6 +810,31 @@ bool NLLocator::init(const Config::Config &config) {
 		if ( prof.controlFile.empty() )
 			prof.controlFile = _controlFilePath;
 
+		try { prof.numThreads = config.getInt(prefix + "numThreads"); }
+		catch ( ... ) { prof.numThreads = 1; }
+
+		if ( prof.numThreads < 0 ) {
+			SEISCOMP_ERROR("NonLinLoc.profile.%s.numThreads: invalid value: %d",
+			               it->c_str(), prof.numThreads);
+			it = _profileNames.erase(it);
+			result = false;
+			continue;
+		}
+
+		if ( prof.numThreads == 0 )
+			prof.numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+		try { prof.metropolisChains = config.getInt(prefix + "metropolisChains"); }
+		catch ( ... ) { prof.metropolisChains = 1; }
+
+		if ( prof.metropolisChains < 1 ) {
+			SEISCOMP_ERROR("NonLinLoc.profile.%s.metropolisChains: invalid value: %d",
+			               it->c_str(), prof.metropolisChains);
+			it = _profileNames.erase(it);
+			result = false;
+			continue;
+		}
+
 		if ( !Util::fileExists(prof.controlFile) ) {
 			SEISCOMP_ERROR("NonLinLoc.profile.%s.controlFile: file %s does not exist",
 			               it->c_str(), prof.controlFile.c_str());
@@ -509,6 +843,14 @@ bool NLLocator::init(const Config::Config &config) {
 			continue;
 		}
 
+		// Parse the control file once, relocations then only check
+		// whether it has been modified
+		if ( !loadControlFile(prof) ) {
+			it = _profileNames.erase(it);
+			result = false;
+			continue;
+		}
+
 		_profiles.push_back(prof);
 
 		++it;
@@ -530,6 +872,63 @@ bool NLLocator::init(const Config::Config &config) {
 		_enableNLLSaveInput = true;
 	}
 
+	try {
+		_enableAsyncOutput = config.getBool("NonLinLoc.asyncOutput");
+	}
+	catch ( ... ) {
+		_enableAsyncOutput = true;
+	}
+
+	try {
+		_outputQueueSize = config.getDouble("NonLinLoc.outputQueueSize");
+	}
+	catch ( ... ) {
+		_outputQueueSize = 64;
+	}
+
+	if ( _outputQueueSize <= 0 ) {
+		SEISCOMP_ERROR("NonLinLoc.outputQueueSize: expected a positive value, got %f",
+		               _outputQueueSize);
+		return false;
+	}
+
+	string outputFormat = "files";
+	try {
+		outputFormat = config.getString("NonLinLoc.outputFormat");
+	}
+	catch ( ... ) {}
+
+	if ( outputFormat == "files" )
+		_enableOutputBundle = false;
+	else if ( outputFormat == "bundle" )
+		_enableOutputBundle = true;
+	else {
+		SEISCOMP_ERROR("NonLinLoc.outputFormat: invalid format: %s, "
+		               "expected files or bundle", outputFormat.c_str());
+		return false;
+	}
+
+	// Replacing a previous writer flushes its pending output
+	_outputWriter.reset(new OutputWriter(_enableAsyncOutput, _enableOutputBundle,
+	                                     (size_t)(_outputQueueSize * 1024 * 1024)));
+
+	try {
+		_enableMapGrids = config.getBool("NonLinLoc.mapGrids");
+	}
+	catch ( ... ) {
+		_enableMapGrids = false;
+	}
+
+	_gridCacheDir = "";
+	try {
+		_gridCacheDir = env->absolutePath(config.getString("NonLinLoc.gridCacheDir"));
+	}
+	catch ( ... ) {}
+
+	// The cache mirrors absolute table paths
+	while ( _gridCacheDir.size() > 1 && _gridCacheDir[_gridCacheDir.size()-1] == '/' )
+		_gridCacheDir.erase(_gridCacheDir.size()-1);
+
 	try {
 		_defaultPickError = config.getDouble("NonLinLoc.defaultPickError");
 	}
@@ -544,6 +943,33 @@ bool NLLocator::init(const Config::Config &config) {
 		_fixedDepthGridSpacing = 0.1;
 	}
 
+	try {
+		_enableDistanceCutOffWarmStart = config.getBool("NonLinLoc.distanceCutOffWarmStart");
+	}
+	catch ( ... ) {
+		_enableDistanceCutOffWarmStart = false;
+	}
+
+	try {
+		_enableInitialWarmStart = config.getBool("NonLinLoc.initialWarmStart");
+	}
+	catch ( ... ) {
+		_enableInitialWarmStart = false;
+	}
+
+	try {
+		_warmStartRadius = config.getDouble("NonLinLoc.warmStartRadius");
+	}
+	catch ( ... ) {
+		_warmStartRadius = 50.0;
+	}
+
+	if ( _warmStartRadius <= 0 ) {
+		SEISCOMP_ERROR("NonLinLoc.warmStartRadius: expected a positive value, got %f",
+		               _warmStartRadius);
+		return false;
+	}
+
 	try {
 		_allowMissingStations = config.getBool("NonLinLoc.allowMissingStations");
 	}
@@ -654,6 +1080,16 @@ int NLLocator::capabilities() const {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Origin* NLLocator::locate(PickList &pickList) {
+	return locate(pickList, false, 0, 0, 0);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Origin* NLLocator::locate(PickList &pickList, bool initialHypocentre,
+                          double initLat, double initLon, double initDepth) {
 	_lastWarning = "";
 
 	if ( pickList.empty() )
@@ -683,6 +1119,16 @@ Origin* NLLocator::locate(PickList &pickList) {
 			throw GeneralException("Wrong earth model set");
 	}
 
+	// Use the copy of the travel time grids preloaded by scnllgridcache
+	// if available
+	if ( !_gridCacheDir.empty() && !earthModelPath.empty() && earthModelPath[0] == '/' ) {
+		string cachedPath = _gridCacheDir + earthModelPath;
+		if ( Util::fileExists(cachedPath + ".cached") ) {
+			SEISCOMP_DEBUG("Using cached travel time grids: %s", cachedPath.c_str());
+			earthModelPath = cachedPath;
+		}
+	}
+
 
 	TextLines obs, params;
 	std::vector<string> observationIDs;
@@ -694,6 +1140,8 @@ Origin* NLLocator::locate(PickList &pickList) {
 			params.push_back(it->first + " " + it->second);
 
 	PickList usedPicks;
+	// Sensor locations of usedPicks, also used by the distance cut-off
+	std::vector<SensorLocation*> usedSensorLocations;
 
 	// create observation buffer
 	for ( PickList::iterator it = pickList.begin();
@@ -702,7 +1150,7 @@ Origin* NLLocator::locate(PickList &pickList) {
 		Pick *pick = it->pick.get();
 		double weight = it->flags & F_TIME?1.0:0.0;
 
-		SensorLocation *sloc = getSensorLocation(pick);
+		SensorLocation *sloc = findSensorLocation(pick);
 		if ( sloc == nullptr ) {
 			if ( _allowMissingStations ) {
 				// Append a new line to the warning message
@@ -724,6 +1172,7 @@ Origin* NLLocator::locate(PickList &pickList) {
 		}
 
 		usedPicks.push_back(*it);
+		usedSensorLocations.push_back(sloc);
 
 		// create the LOCSRCE entries 
 		params.push_back(string("LOCSRCE ") +
@@ -792,6 +1241,9 @@ Origin* NLLocator::locate(PickList &pickList) {
 	SEISCOMP_DEBUG("New origin publicID: %s", origin->publicID().c_str());
 	string outputPath = _outputPath + origin->publicID();
 
+	OutputWriter::Job output;
+	output.path = outputPath;
+
 	if ( globalMode )
 		params.push_back("LOCFILES - NLLOC_OBS " + earthModelPath + " " + outputPath + " 1");
 	else
@@ -866,15 +1318,71 @@ Origin* NLLocator::locate(PickList &pickList) {
 	// call taken from NLL_func_test
 	int return_locations = 1;
 	int return_oct_tree_grid = 1;
-	int return_scatter_sample = 1;
+	// The scatter sample is only needed for the loc.scat artefact, the
+	// expectation and covariance are accumulated while sampling
+	int return_scatter_sample = _enableNLLOutput ? 1 : 0;
 	LocNode *loc_list_head = nullptr;
 
-	int istat = NLLoc(nullptr, nullptr,
-	                  &control_buf[0], (int)control_buf.size(),
-	                  &obs_buf[0], (int)obs_buf.size(), return_locations,
-	                  return_oct_tree_grid, return_scatter_sample, &loc_list_head);
+	// Keep the travel time grids of the first pass in memory for the
+	// distance cut-off pass
+	GridMemoryCache gridCache(_enableDistanceCutOff && _enableDistanceCutOffWarmStart);
+	Util::StopWatch timer;
+
+	NumSearchThreads = _currentProfile->numThreads;
+	MetNumChains = _currentProfile->metropolisChains;
+	GridMemMapFiles = _enableMapGrids ? 1 : 0;
+
+	// Search around the initial hypocentre only if requested
+	TextLines initParams;
+	std::vector<char*> init_control_buf;
+	bool initWarmStart = false;
+	int istat;
+
+	if ( initialHypocentre ) {
+		double x, y, z;
+		if ( toNLLCoordinates(initLat, initLon, initDepth, x, y, z, globalMode) ) {
+			initParams = params;
+			initWarmStart = restrictSearchVolume(initParams, x, y, z,
+			                                     _warmStartRadius, globalMode);
+			if ( initWarmStart ) {
+				init_control_buf = control_buf;
+				for ( size_t i = 0; i < initParams.size(); ++i )
+					init_control_buf[_controlFile.size()+i] = &initParams[i][0];
+			}
+		}
+		else
+			SEISCOMP_DEBUG("Unable to convert initial hypocentre to NLL "
+			               "coordinates, using full search volume");
+	}
 
-	SEISCOMP_DEBUG("NLLoc returned with code %d", istat);
+	if ( initWarmStart ) {
+		istat = NLLoc(nullptr, nullptr,
+		              &init_control_buf[0], (int)init_control_buf.size(),
+		              &obs_buf[0], (int)obs_buf.size(), return_locations,
+		              return_oct_tree_grid, return_scatter_sample, &loc_list_head);
+
+		SEISCOMP_DEBUG("NLLoc (warm start) returned with code %d", istat);
+
+		const LocNode *node = getLocationFromLocList(loc_list_head, 0);
+		if ( !isLocated(node) ||
+		     !isInsideSearchVolume(initParams, params, node->plocation->phypo->x,
+		                           node->plocation->phypo->y, node->plocation->phypo->z) ) {
+			SEISCOMP_DEBUG("Warm start from initial hypocentre failed, "
+			               "repeat with full search volume");
+			freeLocList(loc_list_head, 1);
+			loc_list_head = nullptr;
+			initWarmStart = false;
+		}
+	}
+
+	if ( !initWarmStart ) {
+		istat = NLLoc(nullptr, nullptr,
+		              &control_buf[0], (int)control_buf.size(),
+		              &obs_buf[0], (int)obs_buf.size(), return_locations,
+		              return_oct_tree_grid, return_scatter_sample, &loc_list_head);
+
+		SEISCOMP_DEBUG("NLLoc returned with code %d", istat);
+	}
 
 	int id = 0;
 	LocNode *locNode = getLocationFromLocList(loc_list_head, id);
@@ -893,14 +1401,13 @@ Origin* NLLocator::locate(PickList &pickList) {
 			catch ( ... ) {}
 
 			if ( _enableDistanceCutOff && !rejectedLocation ) {
+				double firstPassSeconds = (double)timer.elapsed();
+
 				// Update input weights for stations within distance
 				// greater that the cut-off
-				for ( PickList::iterator it = usedPicks.begin();
-				      it != usedPicks.end(); ++it ) {
-					Pick *pick = it->pick.get();
-
-					SensorLocation *sloc = getSensorLocation(pick);
-					if ( sloc == nullptr ) continue;
+				for ( size_t i = 0; i < usedPicks.size(); ++i ) {
+					Pick *pick = usedPicks[i].pick.get();
+					SensorLocation *sloc = usedSensorLocations[i];
 					double dist, az, baz;
 
 					// Compute distance from origin to station
@@ -917,18 +1424,63 @@ Origin* NLLocator::locate(PickList &pickList) {
 				for ( size_t i = 0; i < obs.size(); ++i )
 					obs_buf[i] = &obs[i][0];
 
+				// Search around the first solution only if requested
+				TextLines warmParams;
+				std::vector<char*> warm_control_buf;
+				bool warmStart = false;
+
+				if ( _enableDistanceCutOffWarmStart ) {
+					const HypoDesc *phypo = locNode->plocation->phypo;
+					warmParams = params;
+					warmStart = restrictSearchVolume(warmParams, phypo->x, phypo->y, phypo->z,
+					                                 _warmStartRadius, globalMode);
+					if ( warmStart ) {
+						warm_control_buf = control_buf;
+						for ( size_t i = 0; i < warmParams.size(); ++i )
+							warm_control_buf[_controlFile.size()+i] = &warmParams[i][0];
+					}
+				}
+
 				// Free previous results
 				freeLocList(loc_list_head, 1);
 
 				// call NLL again
 				loc_list_head = nullptr;
 				id = 0;
-				istat = NLLoc(nullptr, nullptr,
-				              &control_buf[0], (int)control_buf.size(),
-				              &obs_buf[0], (int)obs_buf.size(), return_locations,
-				              return_oct_tree_grid, return_scatter_sample, &loc_list_head);
+				timer.restart();
+
+				if ( warmStart ) {
+					istat = NLLoc(nullptr, nullptr,
+					              &warm_control_buf[0], (int)warm_control_buf.size(),
+					              &obs_buf[0], (int)obs_buf.size(), return_locations,
+					              return_oct_tree_grid, return_scatter_sample, &loc_list_head);
+
+					SEISCOMP_DEBUG("NLLoc 2nd call (warm start) returned with code %d", istat);
+
+					const LocNode *node = getLocationFromLocList(loc_list_head, id);
+					if ( !isLocated(node) ||
+					     !isInsideSearchVolume(warmParams, params, node->plocation->phypo->x,
+					                           node->plocation->phypo->y, node->plocation->phypo->z) ) {
+						SEISCOMP_DEBUG("Warm start of distance cut-off pass failed, "
+						               "repeat with full search volume");
+						freeLocList(loc_list_head, 1);
+						loc_list_head = nullptr;
+						warmStart = false;
+					}
+				}
 
-				SEISCOMP_DEBUG("NLLoc 2nd call returned with code %d", istat);
+				if ( !warmStart ) {
+					istat = NLLoc(nullptr, nullptr,
+					              &control_buf[0], (int)control_buf.size(),
+					              &obs_buf[0], (int)obs_buf.size(), return_locations,
+					              return_oct_tree_grid, return_scatter_sample, &loc_list_head);
+
+					SEISCOMP_DEBUG("NLLoc 2nd call returned with code %d", istat);
+				}
+
+				SEISCOMP_INFO("NLLoc distance cut-off: 1st pass %.3fs, 2nd pass %.3fs%s",
+				              firstPassSeconds, (double)timer.elapsed(),
+				              warmStart ? " (warm start)" : "");
 
 				validOrigin = false;
 				locNode = getLocationFromLocList(loc_list_head, id);
@@ -956,47 +1508,55 @@ Origin* NLLocator::locate(PickList &pickList) {
 			origin->setMethodID(_currentProfile?_currentProfile->methodID:"NonLinLoc");
 
 			if ( _enableNLLOutput ) {
-				// write NLLoc Hypocenter-Phase file to disk
-				if ( WriteLocation(nullptr, locNode->plocation->phypo, locNode->plocation->parrivals,
-				                   locNode->plocation->narrivals, const_cast<char*>((outputPath + ".loc.hyp").c_str()),
-				                   1, 1, 0, locNode->plocation->pgrid, 0) < 0 )
+				// NLLoc Hypocenter-Phase file
+				OutputWriter::Artefact hyp{"loc.hyp", ""};
+				if ( writeToBuffer(hyp.data, [&](FILE *fp) {
+					return WriteLocation(fp, locNode->plocation->phypo, locNode->plocation->parrivals,
+					                     locNode->plocation->narrivals, const_cast<char*>((outputPath + ".loc.hyp").c_str()),
+					                     1, 1, 0, locNode->plocation->pgrid, 0) >= 0;
+				}) )
+					output.artefacts.push_back(std::move(hyp));
+				else
 					SEISCOMP_ERROR("Failed writing location to event file: %s", (outputPath + ".loc.hyp").c_str());
 
-				// write NLLoc location Grid Header file to disk
-				if ( WriteGrid3dHdr(locNode->plocation->pgrid, nullptr,
-				                    const_cast<char*>(outputPath.c_str()),
-				                    const_cast<char*>("loc")) < 0 )
+				// NLLoc location Grid Header file
+				OutputWriter::Artefact hdr{"loc.hdr", ""};
+				if ( writeToBuffer(hdr.data, [&](FILE *fp) {
+					return WriteGrid3dHdrStream(fp, locNode->plocation->pgrid, nullptr) >= 0;
+				}) )
+					output.artefacts.push_back(std::move(hdr));
+				else
 					SEISCOMP_ERROR("Failed writing grid header to disk: %s", outputPath.c_str());
 
-				// write NLLoc location Oct tree structure of locaiton likelihood values to disk
+				// NLLoc location Oct tree structure of locaiton likelihood values
 				if ( return_oct_tree_grid ) {
-					FILE *fpio = fopen((outputPath + ".loc.octree").c_str(), "w");
-					if ( fpio != nullptr ) {
-						istat = writeTree3D(fpio, locNode->plocation->poctTree);
-						fclose(fpio);
+					OutputWriter::Artefact octree{"loc.octree", ""};
+					if ( writeToBuffer(octree.data, [&](FILE *fp) {
+						istat = writeTree3D(fp, locNode->plocation->poctTree);
+						return istat >= 0;
+					}) ) {
+						output.artefacts.push_back(std::move(octree));
 						SEISCOMP_INFO("Oct tree structure written to file: %d nodes", istat);
 					}
 					else
 						SEISCOMP_ERROR("Failed writing octree grid: %s", (outputPath + ".loc.octree").c_str());
 				}
 
-				// write NLLoc binary Scatter file to disk
+				// NLLoc binary Scatter file: a header record of 4 floats
+				// holding the number of samples and the maximum probability
+				// followed by the samples
 				if ( return_scatter_sample ) {
-					FILE *fpio = fopen((outputPath + ".loc.scat").c_str(), "w");
-					if ( fpio != nullptr ) {
-						// write scatter file header informaion
-						fseek(fpio, 0, SEEK_SET);
-						fwrite(&(locNode->plocation->phypo->nScatterSaved), sizeof(int), 1, fpio);
-						float ftemp = (float) locNode->plocation->phypo->probmax;
-						fwrite(&ftemp, sizeof(float), 1, fpio);
-						// skip header record
-						fseek(fpio, 4 * sizeof(float), SEEK_SET);
-						// write scatter samples
-						fwrite(locNode->plocation->pscatterSample, 4 * sizeof(float), locNode->plocation->phypo->nScatterSaved, fpio);
-						fclose(fpio);
-					}
-					else
-						SEISCOMP_ERROR("Failed writing scatter file: %s", (outputPath + ".loc.scat").c_str());
+					const HypoDesc *phypo = locNode->plocation->phypo;
+					OutputWriter::Artefact scat{"loc.scat", ""};
+					scat.data.assign((4 + 4 * (size_t)phypo->nScatterSaved) * sizeof(float), '\0');
+					char *data = &scat.data[0];
+					memcpy(data, &phypo->nScatterSaved, sizeof(int));
+					float ftemp = (float) phypo->probmax;
+					memcpy(data + sizeof(int), &ftemp, sizeof(float));
+					if ( phypo->nScatterSaved > 0 )
+						memcpy(data + 4 * sizeof(float), locNode->plocation->pscatterSample,
+						       4 * sizeof(float) * phypo->nScatterSaved);
+					output.artefacts.push_back(std::move(scat));
 				}
 			}
 		}
@@ -1006,19 +1566,26 @@ Origin* NLLocator::locate(PickList &pickList) {
 	}
 
 	if ( _enableNLLSaveInput ) {
-		// Save NLL observation input
-		ofstream obsOut((outputPath + ".obs").c_str());
+		// NLL observation input
+		OutputWriter::Artefact obsOut{"obs", ""};
 		for ( size_t i = 0; i < obs_buf.size(); ++i )
-			obsOut << obs_buf[i];
-		obsOut.close();
-
-		// Save NLL control input
-		ofstream controlOut((outputPath + ".conf").c_str());
-		for ( size_t i = 0; i < control_buf.size(); ++i )
-			controlOut << control_buf[i] << endl;
-		controlOut.close();
+			obsOut.data += obs_buf[i];
+		output.artefacts.push_back(std::move(obsOut));
+
+		// NLL control input
+		OutputWriter::Artefact controlOut{"conf", ""};
+		for ( size_t i = 0; i < control_buf.size(); ++i ) {
+			controlOut.data += control_buf[i];
+			controlOut.data += '\n';
+		}
+		output.artefacts.push_back(std::move(controlOut));
 	}
 
+	// Hand the artefacts over to the writer, with asyncOutput enabled
+	// they are written in the background
+	if ( _outputWriter )
+		_outputWriter->push(std::move(output));
+
 	// clean up
 	freeLocList(loc_list_head, 1);
 
@@ -1041,7 +1608,7 @@ Origin* NLLocator::locate(PickList &pickList) {
 Origin* NLLocator::locate(PickList &pickList,
                            double initLat, double initLon, double initDepth,
                            const Time &initTime) {
-	return locate(pickList);
+	return locate(pickList, _enableInitialWarmStart, initLat, initLon, initDepth);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -1056,7 +1623,18 @@ Origin* NLLocator::relocate(const Origin *origin) {
 
 	double lat = origin->latitude().value();
 	double lon = origin->longitude().value();
+	double depth = 0;
 	bool   emptyProfile = false;
+	bool   initialHypocentre = false;
+
+	// Use the input hypocentre as starting point of the search
+	if ( _enableInitialWarmStart ) {
+		try {
+			depth = origin->depth().value();
+			initialHypocentre = true;
+		}
+		catch ( ... ) {}
+	}
 
 	SEISCOMP_DEBUG("Relocating origin with publicID: %s", origin->publicID().c_str());
 
@@ -1141,7 +1719,7 @@ Origin* NLLocator::relocate(const Origin *origin) {
 	*/
 
 	try {
-		org = locate(picks);
+		org = locate(picks, initialHypocentre, lat, lon, depth);
 	}
 	catch ( GeneralException &exc ) {
 		if ( emptyProfile ) _currentProfile = nullptr;
@@ -1187,7 +1765,7 @@ Origin* NLLocator::relocate(const Origin *origin) {
 				SEISCOMP_DEBUG("next earth model: %s", _currentProfile->earthModelID.c_str());
 
 				try {
-					org = locate(picks);
+					org = locate(picks, initialHypocentre, lat, lon, depth);
 				}
 				catch ( GeneralException &exc ) {
 					delete lastWorkingOrg;
@@ -1259,49 +1837,288 @@ void NLLocator::updateProfile(const std::string &name) {
 		it->second = "";
 
 	if ( _currentProfile ) {
-		string controlFile;
-		if ( !_currentProfile->controlFile.empty() )
-			controlFile = _currentProfile->controlFile;
-		else if ( !_controlFilePath.empty() )
-			controlFile = _controlFilePath;
-
-		if ( !controlFile.empty() ) {
-			SEISCOMP_DEBUG("Reading control file: %s", controlFile.c_str());
-			ifstream f(controlFile.c_str());
-			if ( !f.is_open() ) {
-				SEISCOMP_ERROR("NonLinLoc: unable to open control file at %s",
-				               controlFile.c_str());
-				return;
-			}
+		if ( !loadControlFile(*_currentProfile) ) return;
 
-			while ( f.good() ) {
-				string line;
-				getline(f, line);
-				Core::trim(line);
-				// ignore empty lines
-				if ( line.empty() ) continue;
-				// ignore comments
-				if ( line[0] == '#' ) continue;
-
-				size_t pos = line.find_first_of(" \t\r\n");
-				if ( pos != string::npos ) {
-					string param = line.substr(0, pos);
-					// Lookup the parameter name in the local parameter map
-					// If not available pass it to NLL directly without being able
-					// to modify it.
-					ParameterMap::iterator it = _parameters.find(param);
-					if ( it == _parameters.end() )
-						_controlFile.push_back(line);
-					else {
-						it->second = line.substr(pos+1);
-						Core::trim(it->second);
-					}
-				}
-				else
-					_controlFile.push_back(line);
+		_controlFile = _currentProfile->controlLines;
+		for ( ParameterMap::const_iterator it = _currentProfile->controlParameters.begin();
+		      it != _currentProfile->controlParameters.end(); ++it )
+			_parameters[it->first] = it->second;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool NLLocator::loadControlFile(Profile &prof) {
+	string controlFile;
+	if ( !prof.controlFile.empty() )
+		controlFile = prof.controlFile;
+	else if ( !_controlFilePath.empty() )
+		controlFile = _controlFilePath;
+
+	if ( controlFile.empty() ) {
+		prof.controlLines.clear();
+		prof.controlParameters.clear();
+		prof.controlFileLoaded = true;
+		return true;
+	}
+
+	struct stat st;
+	if ( stat(controlFile.c_str(), &st) != 0 ) {
+		SEISCOMP_ERROR("NonLinLoc: unable to open control file at %s",
+		               controlFile.c_str());
+		return false;
+	}
+
+	// Cached content still up to date? Seconds alone miss edits made
+	// within the same second as the last read.
+	if ( prof.controlFileLoaded
+	  && st.st_mtim.tv_sec == prof.controlFileMTime.tv_sec
+	  && st.st_mtim.tv_nsec == prof.controlFileMTime.tv_nsec
+	  && st.st_size == prof.controlFileSize )
+		return true;
+
+	SEISCOMP_DEBUG("Reading control file: %s", controlFile.c_str());
+	ifstream f(controlFile.c_str());
+	if ( !f.is_open() ) {
+		SEISCOMP_ERROR("NonLinLoc: unable to open control file at %s",
+		               controlFile.c_str());
+		return false;
+	}
+
+	prof.controlLines.clear();
+	prof.controlParameters.clear();
+
+	while ( f.good() ) {
+		string line;
+		getline(f, line);
+		Core::trim(line);
+		// ignore empty lines
+		if ( line.empty() ) continue;
+		// ignore comments
+		if ( line[0] == '#' ) continue;
+
+		size_t pos = line.find_first_of(" \t\r\n");
+		if ( pos != string::npos ) {
+			string param = line.substr(0, pos);
+			// Lookup the parameter name in the local parameter map
+			// If not available pass it to NLL directly without being able
+			// to modify it.
+			if ( _parameters.find(param) == _parameters.end() )
+				prof.controlLines.push_back(line);
+			else {
+				string &value = prof.controlParameters[param];
+				value = line.substr(pos+1);
+				Core::trim(value);
 			}
 		}
+		else
+			prof.controlLines.push_back(line);
 	}
+
+	prof.controlFileMTime = st.st_mtim;
+	prof.controlFileSize = st.st_size;
+	prof.controlFileLoaded = true;
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool NLLocator::restrictSearchVolume(TextLines &params,
+                                     double x, double y, double z,
+                                     double radius, bool globalMode) const {
+	TextLines::iterator locGrid = findParameterLine(params, "LOCGRID");
+	if ( locGrid == params.end() ) return false;
+
+	vector<string> toks;
+	int num[3];
+	double orig[3], step[3];
+	if ( !parseLocGrid(*locGrid, toks, num, orig, step) ) return false;
+
+	double center[3] = { x, y, z };
+	double extent[3] = { radius, radius, radius };
+
+	if ( globalMode ) {
+		// Horizontal grid coordinates are given in degrees
+		extent[1] = Math::Geo::km2deg(radius);
+		extent[0] = extent[1] / std::max(cos(deg2rad(y)), 0.01);
+	}
+
+	int oldNum[3] = { num[0], num[1], num[2] };
+	double volumeRatio = 1.0;
+
+	// The depth axis is already fixed by the caller
+	int numAxes = _usingFixedDepth ? 2 : 3;
+
+	for ( int i = 0; i < numAxes; ++i ) {
+		if ( num[i] < 2 || step[i] <= 0 ) continue;
+
+		// Snap to nodes of the configured grid
+		int i0 = std::max(0, (int)floor((center[i] - extent[i] - orig[i]) / step[i]));
+		int i1 = std::min(num[i]-1, (int)ceil((center[i] + extent[i] - orig[i]) / step[i]));
+		if ( i1 <= i0 ) return false;
+
+		orig[i] += i0 * step[i];
+		num[i] = i1 - i0 + 1;
+		volumeRatio *= double(num[i]-1) / double(oldNum[i]-1);
+	}
+
+	// Nothing to gain
+	if ( volumeRatio >= 1.0 ) return false;
+
+	for ( int i = 0; i < 3; ++i ) {
+		toks[1+i] = Core::toString(num[i]);
+		toks[4+i] = Core::toString(orig[i]);
+	}
+
+	*locGrid = joinTokens(toks);
+
+	// Keep the size of the initial oct-tree cells and reduce the number
+	// of nodes according to the volume
+	TextLines::iterator locSearch = findParameterLine(params, "LOCSEARCH");
+	if ( locSearch == params.end() ) return true;
+
+	Core::split(toks, locSearch->c_str(), " \t\r\n", true);
+	if ( toks.size() < 7 || toks[1] != "OCT" ) return true;
+
+	for ( int i = 0; i < 3; ++i ) {
+		int initNum;
+		if ( oldNum[i] < 2 || !fromString(initNum, toks[2+i]) ) continue;
+		initNum = (int)ceil(initNum * double(num[i]-1) / double(oldNum[i]-1));
+		toks[2+i] = Core::toString(std::max(initNum, 1));
+	}
+
+	int maxNumNodes;
+	if ( fromString(maxNumNodes, toks[6]) )
+		toks[6] = Core::toString(std::max((int)(maxNumNodes * volumeRatio),
+		                                  maxNumNodes / 4));
+
+	*locSearch = joinTokens(toks);
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool NLLocator::isInsideSearchVolume(TextLines &params, TextLines &fullParams,
+                                     double x, double y, double z) const {
+	TextLines::iterator locGrid = findParameterLine(params, "LOCGRID");
+	TextLines::iterator fullLocGrid = findParameterLine(fullParams, "LOCGRID");
+	if ( locGrid == params.end() || fullLocGrid == fullParams.end() )
+		return false;
+
+	vector<string> toks;
+	int num[3], fullNum[3];
+	double orig[3], step[3], fullOrig[3], fullStep[3];
+	if ( !parseLocGrid(*locGrid, toks, num, orig, step) ||
+	     !parseLocGrid(*fullLocGrid, toks, fullNum, fullOrig, fullStep) )
+		return false;
+
+	double pos[3] = { x, y, z };
+
+	for ( int i = 0; i < 3; ++i ) {
+		if ( num[i] < 2 || step[i] <= 0 ) continue;
+
+		double lo = orig[i], hi = orig[i] + (num[i]-1) * step[i];
+		double fullLo = fullOrig[i], fullHi = fullOrig[i] + (fullNum[i]-1) * fullStep[i];
+
+		// A maximum within 5% of the extent of a boundary indicates that
+		// the solution might be located outside of the restricted volume.
+		double margin = 0.05 * (hi - lo);
+
+		if ( lo - fullLo > 0.5 * step[i] && pos[i] < lo + margin )
+			return false;
+
+		if ( fullHi - hi > 0.5 * step[i] && pos[i] > hi - margin )
+			return false;
+	}
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool NLLocator::toNLLCoordinates(double lat, double lon, double depth,
+                                 double &x, double &y, double &z,
+                                 bool globalMode) const {
+	z = depth;
+
+	if ( globalMode ) {
+		x = lon;
+		y = lat;
+		return true;
+	}
+
+	// The last TRANS statement wins as in NLLoc
+	const string *trans = nullptr;
+	for ( TextLines::const_iterator it = _controlFile.begin();
+	      it != _controlFile.end(); ++it ) {
+		if ( it->size() > 5 && it->compare(0, 5, "TRANS") == 0 && isspace((*it)[5]) )
+			trans = &(*it);
+	}
+
+	if ( trans == nullptr ) return false;
+
+	// Initialize the projection as NLLoc will do it when reading the
+	// control file
+	string transform = trans->substr(5);
+	if ( get_transform(0, &transform[0]) < 0 ) return false;
+
+	return latlon2rect(0, lat, lon, &x, &y) == 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+SensorLocation *NLLocator::findSensorLocation(const Pick *pick) {
+	const WaveformStreamID &wid = pick->waveformID();
+	Core::Time time = pick->time().value();
+
+	string key = wid.networkCode() + "." + wid.stationCode() + "." + wid.locationCode();
+	vector<SensorLocationEpoch> &epochs = _sensorLocationCache[key];
+
+	for ( size_t i = 0; i < epochs.size(); ++i ) {
+		const SensorLocationEpoch &epoch = epochs[i];
+		if ( time < epoch.start ) continue;
+		if ( epoch.hasEnd && time >= epoch.end ) continue;
+		return epoch.location.get();
+	}
+
+	// Not yet cached, resolve it through the inventory
+	SensorLocation *sloc = getSensorLocation(pick);
+	if ( sloc == nullptr ) return nullptr;
+
+	SensorLocationEpoch epoch;
+	epoch.start = sloc->start();
+	try {
+		epoch.end = sloc->end();
+		epoch.hasEnd = true;
+	}
+	catch ( ... ) {
+		epoch.hasEnd = false;
+	}
+	epoch.location = sloc;
+
+	// Only cache epochs that contain the pick time, otherwise the lookup
+	// above would never match
+	if ( time >= epoch.start && (!epoch.hasEnd || time < epoch.end) )
+		epochs.push_back(epoch);
+
+	return sloc;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -1382,7 +2199,7 @@ bool NLLocator::NLL2SC3(Origin *origin, string &locComment, const void *vnode,
 		PickPtr pick = picks[i].pick;
 
 		// Skip unknown station
-		SensorLocation *sloc = getSensorLocation(pick.get());
+		SensorLocation *sloc = findSensorLocation(pick.get());
 		if ( sloc == nullptr ) continue;
 
 		// Compute distance and azimuth
@@ -1484,6 +2301,15 @@ bool NLLocator::NLL2SC3(Origin *origin, string &locComment, const void *vnode,
 		origin->add(comment.get());
 	}
 
+	// Convergence of a multi-chain Metropolis search
+	if ( phypo->nChains > 1 ) {
+		CommentPtr comment = new Comment;
+		comment->setId("NLL.metropolisRhat");
+		comment->setText(Core::stringify("%d chains, Gelman-Rubin R x %.3f y %.3f z %.3f",
+		                                 phypo->nChains, phypo->rhat.x, phypo->rhat.y, phypo->rhat.z));
+		origin->add(comment.get());
+	}
+
 	if ( strcmp(phypo->locStat, "LOCATED") != 0 ) {
 		origin->setEvaluationStatus(EvaluationStatus(REJECTED));
 		locComment = phypo->locStatComm;
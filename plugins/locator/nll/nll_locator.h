@@ -17,7 +17,13 @@
 
 #include <seiscomp/core/plugin.h>
 #include <seiscomp/seismology/locatorinterface.h>
+#include <seiscomp/datamodel/sensorlocation.h>
+#include <sys/types.h>
+#include <ctime>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 
 namespace Seiscomp {
@@ -90,8 +96,43 @@ class NLLocator : public Seiscomp::Seismology::LocatorInterface {
 	//  Private methods
 	// ----------------------------------------------------------------------
 	private:
+		struct Profile;
+		class OutputWriter;
+
 		void updateProfile(const std::string &name);
 
+		//! Reads and parses the control file of a profile unless the
+		//! cached content is still up to date. Returns false if the
+		//! file could not be read.
+		bool loadControlFile(Profile &prof);
+
+		//! Restricts LOCGRID and LOCSEARCH OCT of the given parameters to
+		//! a volume of the given radius (km) around x, y, z given in NLL
+		//! coordinates. Returns false if the volume could not be restricted.
+		bool restrictSearchVolume(std::vector<std::string> &params,
+		                          double x, double y, double z,
+		                          double radius, bool globalMode) const;
+
+		//! Returns whether x, y, z lies inside the restricted LOCGRID of
+		//! params and not close to one of its boundaries which are not
+		//! boundaries of the full LOCGRID as well.
+		bool isInsideSearchVolume(std::vector<std::string> &params,
+		                          std::vector<std::string> &fullParams,
+		                          double x, double y, double z) const;
+
+		//! Converts a geographic hypocentre to NLL coordinates using the
+		//! transformation of the current profile.
+		bool toNLLCoordinates(double lat, double lon, double depth,
+		                      double &x, double &y, double &z,
+		                      bool globalMode) const;
+
+		DataModel::Origin* locate(PickList &pickList, bool initialHypocentre,
+		                          double initLat, double initLon, double initDepth);
+
+		//! Returns the sensor location of the stream of a pick at pick
+		//! time. Resolved sensor locations are cached per stream.
+		DataModel::SensorLocation *findSensorLocation(const DataModel::Pick *pick);
+
 		bool NLL2SC3(DataModel::Origin *origin, std::string &locComment,
 		             const void *node, const PickList &picks,
 		             bool depthFixed);
@@ -101,25 +142,48 @@ class NLLocator : public Seiscomp::Seismology::LocatorInterface {
 	//  Private members
 	// ----------------------------------------------------------------------
 	private:
+		typedef std::map<std::string, std::string> ParameterMap;
+		typedef std::vector<std::string> TextLines;
+
 		struct Profile {
-			std::string name;
-			std::string earthModelID;
-			std::string methodID;
-			std::string tablePath;
-			std::string stationNameFormat;
-			std::string controlFile;
-			RegionPtr   region;
+			std::string  name;
+			std::string  earthModelID;
+			std::string  methodID;
+			std::string  tablePath;
+			std::string  stationNameFormat;
+			std::string  controlFile;
+			RegionPtr    region;
+			int          numThreads;
+			int          metropolisChains;
+
+			// Parsed control file, cached between relocations and
+			// re-read only if the modification time (with nanoseconds)
+			// or the size of the file has changed
+			TextLines    controlLines;
+			ParameterMap controlParameters;
+			timespec     controlFileMTime;
+			off_t        controlFileSize;
+			bool         controlFileLoaded;
 		};
 
-		typedef std::map<std::string, std::string> ParameterMap;
-		typedef std::vector<std::string> TextLines;
 		typedef std::list<Profile> Profiles;
 
+		struct SensorLocationEpoch {
+			Core::Time                   start;
+			Core::Time                   end;
+			bool                         hasEnd;
+			DataModel::SensorLocationPtr location;
+		};
+
+		//! Sensor location epochs indexed by NET.STA.LOC
+		typedef std::unordered_map<std::string, std::vector<SensorLocationEpoch> > SensorLocationCache;
+
 		static IDList _allowedParameters;
 
 		std::string   _publicIDPattern;
 		std::string   _outputPath;
 		std::string   _controlFilePath;
+		std::string   _gridCacheDir;
 		std::string   _lastWarning;
 		std::string   _SEDqualityTag;
 		std::string   _SEDdiffMaxLikeExpectTag;
@@ -128,14 +192,25 @@ class NLLocator : public Seiscomp::Seismology::LocatorInterface {
 
 		double        _fixedDepthGridSpacing;
 		double        _defaultPickError;
+		double        _warmStartRadius;
+		bool          _enableDistanceCutOffWarmStart;
+		bool          _enableInitialWarmStart;
+		bool          _enableMapGrids;
 		bool          _allowMissingStations;
 		bool          _enableSEDParameters;
 		bool          _enableNLLOutput;
 		bool          _enableNLLSaveInput;
+		bool          _enableAsyncOutput;
+		bool          _enableOutputBundle;
+		double        _outputQueueSize;
 
 		ParameterMap  _parameters;
 		Profiles      _profiles;
 		Profile      *_currentProfile;
+
+		SensorLocationCache _sensorLocationCache;
+
+		std::unique_ptr<OutputWriter> _outputWriter;
 };
 
 
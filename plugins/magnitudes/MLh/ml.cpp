@@ -27,7 +27,10 @@
 #include <seiscomp/math/filter/seismometers.h>
 #include <seiscomp/math/geo.h>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 #include <boost/bind.hpp>
 #include <unistd.h>
@@ -124,6 +127,27 @@ Processing::AmplitudeProcessor::AmplitudeTime average(
 }
 
 
+// Returns the index of the first sample with an absolute value above
+// threshold or n if there is none. Clipping is rare, so the whole block is
+// first tested with a branch-free select loop which the compiler can
+// vectorise and the index is only searched for if that test fails.
+size_t findClipped(size_t n, const double *samples, double threshold) {
+	double clipped = 0;
+
+	for ( size_t i = 0; i < n; ++i )
+		clipped = abs(samples[i]) > threshold ? 1 : clipped;
+
+	if ( clipped == 0 ) return n;
+
+	for ( size_t i = 0; i < n; ++i ) {
+		if ( abs(samples[i]) > threshold )
+			return i;
+	}
+
+	return n;
+}
+
+
 ADD_SC_PLUGIN(
 	"MLh magnitude method (max of both horizontal compontents)",
 	"gempa GmbH, modified by Stefan Heimers at the SED",
@@ -147,13 +171,10 @@ class AmplitudeProcessor_MLh : public Processing::AbstractAmplitudeProcessor_ML
 		// Discard clipped signals
 		// TODO: test and improve this!
 		void fill(size_t n, double *samples) override {
-			SEISCOMP_DEBUG("AmplitudeProcessor_MLh:fill() was used with limit %f!",ClippingThreshold);
-			for ( size_t i = 0; i < n; ++i ) {
-				if ( abs(samples[i]) > ClippingThreshold ) {
-					setStatus(DataClipped, samples[i]);
-					SEISCOMP_DEBUG("AmplitudeProcessor_MLh:fill(): DataClipped at index %ld, value %f",(long int)i,samples[i]);
-					break;
-				}
+			size_t i = findClipped(n, samples, ClippingThreshold);
+			if ( i < n ) {
+				setStatus(DataClipped, samples[i]);
+				SEISCOMP_DEBUG("AmplitudeProcessor_MLh:fill(): DataClipped at index %ld, value %f",(long int)i,samples[i]);
 			}
 			AbstractAmplitudeProcessor_ML::fill(n, samples); // this will apply a filter
 		}
@@ -309,6 +330,7 @@ class AmplitudeProcessor_ML2h : public Processing::AmplitudeProcessor {
 			}
 
 			_ampE.ClippingThreshold=_ampN.ClippingThreshold;
+			SEISCOMP_DEBUG("AmplitudeProcessor_MLh: using clipping threshold %f", _ampN.ClippingThreshold);
 
 			return true;
 		}
@@ -557,8 +579,9 @@ class MagnitudeProcessor_ML : public Processing::MagnitudeProcessor {
 			bool nomag;
 		};
 
-		list<param_struct> list_of_parametersets;
-		param_struct selected_parameterset;
+		// Calibration parameter sets sorted by range, sets with equal
+		// ranges are kept in configuration order
+		vector<param_struct> list_of_parametersets;
 		double maxDepth;
 
 
@@ -638,10 +661,9 @@ class MagnitudeProcessor_ML : public Processing::MagnitudeProcessor {
 		}
 
 	private:
-		// create a C++ list of structs containing all configured
-		// parameter sets.
+		// create a sorted table of all configured parameter sets.
 		// run this once at program start
-		bool initParameters(list<param_struct> &paramlist, const string &params) {
+		bool initParameters(vector<param_struct> &paramlist, const string &params) {
 			string paramset, range_str,minrange_str;
 			string A_str, B_str;
 
@@ -680,33 +702,42 @@ class MagnitudeProcessor_ML : public Processing::MagnitudeProcessor {
 					new_paramset.nomag = false;
 				}
 
+				// A range which is not a number can never be selected
+				if ( std::isnan(new_paramset.dist) ) continue;
+
 				paramlist.push_back(new_paramset);
 			}
 
+			std::stable_sort(paramlist.begin(), paramlist.end(), lessRange);
+
 			return true;
 		}
 
 
-		// select the right parameter set for a given distance. init_parameters() must
+		static bool lessRange(const param_struct &p1, const param_struct &p2) {
+			return p1.dist < p2.dist;
+		}
+
+
+		static bool rangeLessThan(const param_struct &p, double distance) {
+			return p.dist < distance;
+		}
+
+
+		// select the parameter set with the smallest range not less than the
+		// given distance. Returns NULL if there is none. init_parameters() must
 		// have been called before using this function.
-		param_struct selectParameters(double distance, const list<param_struct> &paramlist) {
-			double last_dist = 1000000; // arbitrary number larger than any expected distance;
-			param_struct selected_parameters;
-
-			// defaults in case the distance is out of the definded ranges
-			selected_parameters.nomag=true;
-			selected_parameters.dist=0;
-			selected_parameters.A=0;
-			selected_parameters.B=0;
-
-			list<param_struct>::const_iterator paramit;
-			for ( paramit = paramlist.begin(); paramit != paramlist.end(); ++paramit ) {
-				if ( (paramit->dist < last_dist) && (paramit->dist >= distance) ) {
-					selected_parameters = *paramit;
-					last_dist = paramit->dist;
-				}
-			}
-			return selected_parameters;
+		const param_struct *selectParameters(double distance, const vector<param_struct> &paramlist) const {
+			vector<param_struct>::const_iterator it;
+			it = lower_bound(paramlist.begin(), paramlist.end(), distance, rangeLessThan);
+
+			// The former linear search started with an arbitrary number
+			// larger than any expected distance, larger ranges were never
+			// selected
+			if ( it == paramlist.end() || !(it->dist >= distance) || it->dist >= 1000000 )
+				return NULL;
+
+			return &*it;
 		}
 
 
@@ -714,7 +745,7 @@ class MagnitudeProcessor_ML : public Processing::MagnitudeProcessor {
 			double amplitude, // in micrometers
 			double delta,     // in degrees
 			double depth,     // in kilometers
-			double *mag) {
+			double *mag) const {
 
 			float epdistkm,hypdistkm;
 
@@ -743,20 +774,20 @@ class MagnitudeProcessor_ML : public Processing::MagnitudeProcessor {
 
 			// read the values for A, B and epdistkm from the config file and
 			// select the right set depending on the distance
-			selected_parameterset = selectParameters(hypdistkm, list_of_parametersets);
+			const param_struct *selected_parameterset = selectParameters(hypdistkm, list_of_parametersets);
 
 			SEISCOMP_DEBUG("Epdistkm: %f\n",epdistkm);
 			SEISCOMP_DEBUG("Hypdistkm: %f\n",hypdistkm);
 
-			if ( selected_parameterset.nomag ) {
+			if ( selected_parameterset == NULL || selected_parameterset->nomag ) {
 				SEISCOMP_DEBUG( "Epicentral distance out of configured range, no magnitude");
 				return DistanceOutOfRange;
 			}
 			else {
-				SEISCOMP_DEBUG("The selected range is: %f", selected_parameterset.dist);
-				SEISCOMP_DEBUG("  + A:     %f", selected_parameterset.A);
-				SEISCOMP_DEBUG("  + B:     %f", selected_parameterset.B);
-				*mag = log10(amplitude)  + selected_parameterset.A * hypdistkm + selected_parameterset.B;
+				SEISCOMP_DEBUG("The selected range is: %f", selected_parameterset->dist);
+				SEISCOMP_DEBUG("  + A:     %f", selected_parameterset->A);
+				SEISCOMP_DEBUG("  + B:     %f", selected_parameterset->B);
+				*mag = log10(amplitude)  + selected_parameterset->A * hypdistkm + selected_parameterset->B;
 				return OK;
 			}
 		}